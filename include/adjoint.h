@@ -0,0 +1,23 @@
+#ifndef ADJOINT_H
+#define ADJOINT_H
+
+#include "trotter.h"
+
+// Градиенты <H> = <psi|U^+ H U|psi> по углам всех вентилей RX, RZ и CP схемы методом сопряженных состояний:
+// прямой проход, lambda = H psi, затем обратный проход, снимающий вентили с psi и lambda.
+// Нужны только два вектора: производная по углу - это <lambda|G|psi_k> для генератора G вентиля (X, Z или
+// проектор |11><11| = (I - CZ) / 2), G применяется к psi ядрами вентилей и снимается вместе со следующими
+// вентилями, произведение считается dot. Обратный проход стоит двух прямых, все градиенты - около трех
+
+// Вентиль с углом
+bool gate_has_parameter(const gate &g);
+
+// Коллективная: lambda = H psi, psi не меняется (вентили слагаемых применяются к нему и снимаются)
+int apply_hamiltonian(complexd *psi, complexd *lambda, const size_t number_of_qubits, const std::vector<pauli_term> &terms);
+
+// Коллективная. На входе psi - начальное состояние, на выходе psi и lambda испорчены.
+// gradients[k] - производная по углу k-го вентиля с углом в порядке схемы. Измерение не поддерживается
+int adjoint_gradients(complexd *psi, complexd *lambda, const size_t number_of_qubits, const gate *gates, const size_t count,
+	const std::vector<pauli_term> &terms, double *energy, std::vector<double> &gradients);
+
+#endif		//defines ADJOINT_H
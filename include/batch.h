@@ -0,0 +1,21 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "gates.h"
+#include <string>
+#include <vector>
+
+// Пачка векторов одной размерности, хранящихся вперемешку: амплитуда i вектора s лежит в portion[i*states + s]
+// (см. apply_circuit_batch). Вектор s пачки читается из files[s] и пишется в files[s], states == files.size()
+
+int batch_alloc(complexd **portion, const size_t number_of_qubits, const size_t states);
+void batch_free(complexd *portion);
+// Каждый процесс читает свою часть каждого файла
+int batch_read_vectors(complexd *portion, const size_t number_of_qubits, const std::vector<std::string> &files);
+// Не коллективная: процесс читает свою часть файла в вектор s пачки, поэтому ее можно вызывать из другого потока
+int batch_read_portion(complexd *portion, const size_t number_of_qubits, const size_t states, const size_t s, const char *filename);
+int batch_write_vectors(const complexd *portion, const size_t number_of_qubits, const std::vector<std::string> &files);
+// Файл со строками "<входной файл> <выходной файл>"
+int read_batch_list(const char *filename, std::vector<std::string> &inputs, std::vector<std::string> &outputs);
+
+#endif		//defines BATCH_H
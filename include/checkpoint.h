@@ -0,0 +1,52 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "gates.h"
+#include <string>
+#include <vector>
+
+// Кэш промежуточных состояний для серий запусков с общим началом схемы (перебор углов в последних слоях,
+// правки хвоста схемы). Ключ состояния - цепочка хешей: хеш входного вектора, затем каждого вентиля префикса.
+// Состояния хранятся в памяти, вытесненные (по давности использования) - в файлах <spill_prefix>.<ключ>.<myrank>
+// на локальном диске, если он задан. Все процессы принимают одинаковые решения, поэтому кэш у них согласован
+
+struct checkpoint_entry
+{
+	ulong key;
+	size_t prefix;				// число вентилей префикса
+	size_t number_of_qubits;
+	complexd *portion;			// NULL - состояние в файле spill_file
+	std::string spill_file;
+	ulong last_use;
+};
+
+struct checkpoint_cache
+{
+	ulong memory_limit;			// байт на процесс
+	ulong spill_limit;
+	std::string spill_prefix;	// пустой - вытесненные состояния отбрасываются
+	ulong memory_used;
+	ulong spill_used;
+	ulong clock;
+	std::vector<checkpoint_entry> entries;
+	// цепочки хешей последних запусков: по ним находится общий префикс, который стоит сохранить
+	std::vector<std::vector<ulong> > history;
+	// статистика
+	size_t runs;
+	size_t hits;
+	size_t gates_skipped;
+	size_t gates_total;
+	size_t spilled;
+};
+
+void checkpoint_cache_init(checkpoint_cache *cache, const size_t memory_mb, const char *spill_prefix, const size_t spill_mb);
+// Освобождает память и удаляет файлы вытесненных состояний
+void checkpoint_cache_free(checkpoint_cache *cache);
+
+// Коллективная: как apply_circuit_dense, но продолжает с самого длинного сохраненного префикса. Если начало схемы
+// совпадает с одним из прошлых запусков дальше, чем сохраненный префикс, состояние в конце общей части сохраняется.
+// Префиксы с измерением не сохраняются: его исход случаен
+int checkpoint_apply_circuit(checkpoint_cache *cache, complexd *portion, const size_t number_of_qubits, const gate *gates,
+	const size_t count, std::vector<int> *bits = NULL);
+
+#endif		//defines CHECKPOINT_H
@@ -0,0 +1,47 @@
+#ifndef CIRCUIT_H
+#define CIRCUIT_H
+
+#include "gates.h"
+#include <stdio.h>
+#include <map>
+#include <string>
+#include <vector>
+
+// Подмножество OpenQASM 2: qreg, creg, h, x, z, rx, rz, cx, cp (cu1), ccx, swap, measure, barrier
+// и макрос qft <регистр>, раскрывающийся в те же вентили, что и qft_transform.
+// Кубит q[k] первого регистра - это кубит k+1 в нумерации библиотеки (q[0] - старший бит индекса),
+// следующие регистры продолжают нумерацию.
+// Файл разбирается на рутовом процессе пачками вентилей, каждая пачка рассылается всем процессам,
+// поэтому выполнение начинается сразу, не дожидаясь разбора всего файла.
+
+#define CIRCUIT_BATCH 4096
+
+struct qasm_register
+{
+	size_t offset;
+	size_t size;
+};
+
+struct circuit_parser
+{
+	FILE *input;
+	size_t number_of_qubits;	// столько кубитов у вектора, регистры не должны выходить за них
+	size_t qubits_declared;
+	size_t line;
+	size_t bits_declared;
+	std::map<std::string, qasm_register> qregs;
+	std::map<std::string, qasm_register> cregs;
+	std::vector<gate> pending;	// вентили раскрытого макроса, не поместившиеся в пачку
+};
+
+int circuit_open(circuit_parser *parser, const char *filename, const size_t number_of_qubits);
+// Коллективная операция: рутовый процесс разбирает до max_gates вентилей и рассылает их.
+// Пустая пачка - конец файла
+int circuit_next_batch(circuit_parser *parser, std::vector<gate> &batch, const size_t max_gates = CIRCUIT_BATCH);
+void circuit_close(circuit_parser *parser);
+// Весь файл целиком, для исполнителей, которым нужна вся схема сразу
+int read_circuit(const char *filename, const size_t number_of_qubits, std::vector<gate> &gates);
+// Имя вентиля type в OpenQASM (первое из имен таблицы разбора)
+const char *gate_name(const int type);
+
+#endif		//defines CIRCUIT_H
@@ -0,0 +1,29 @@
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include "ooc.h"
+#include <vector>
+
+#define COMPRESS_MIN_ERROR_BOUND 1e-15
+
+// Часть вектора хранится в памяти сжатыми блоками, каждый блок сжимается независимо.
+// error_bound == 0 - без потерь (перестановка байтов и LZ),
+// иначе каждая компонента квантуется на решетку с шагом 2*error_bound, ошибка одной записи не больше error_bound.
+// Неизмененные значения уже лежат на решетке и не округляются повторно, но каждый проход, меняющий блок,
+// добавляет до error_bound: после k таких проходов ошибка компоненты до k*error_bound.
+// error_bound меньше COMPRESS_MIN_ERROR_BOUND не принимается: шаг мельче точности double ничего не дает
+class compressed_storage: public block_storage
+{
+	ulong block_size;
+	double error_bound;
+	std::vector< std::vector<unsigned char> > blocks;
+public:
+	compressed_storage(): block_size(0), error_bound(0) {}
+	int init(const ulong portion_size, const ulong _block_size, const double _error_bound);
+	int load(const ulong block_num, complexd *buffer);
+	int store(const ulong block_num, const complexd *buffer);
+	// суммарный размер сжатых блоков в байтах
+	ulong compressed_bytes() const;
+};
+
+#endif		//defines COMPRESS_H
@@ -0,0 +1,25 @@
+#ifndef DENSITY_H
+#define DENSITY_H
+
+#include "noise.h"
+
+// Матрица плотности n кубитов хранится как распределенный вектор 2n кубитов: rho[r][c] лежит в индексе r*2^n + c.
+// Кубит q строки - кубит q вектора, кубит q столбца - кубит q + n. U rho U^+ - это U на кубитах строки
+// и U* на кубитах столбца, поэтому схема выполняется тем же apply_circuit_dense.
+// Полные векторы psi (2^n амплитуд) есть на каждом процессе
+
+// Каждый процесс читает весь файл вектора
+int read_full_vector(complexd *psi, const size_t number_of_qubits, const char *filename);
+// rho = |psi><psi|
+void density_from_pure(complexd *rho, const size_t number_of_qubits, const complexd *psi);
+// Схема с шумом model после каждого вентиля на каждом его кубите - точное среднее траекторий run_trajectories.
+// Шум применяется локальным ядром супероператора 4x4 к биту строки и биту столбца за один проход;
+// глобальный бит строки на это время меняется местами с младшим кубитом. Измерение не поддерживается
+int density_apply(complexd *rho, const size_t number_of_qubits, const gate *gates, const size_t count, const noise_model *model);
+// Коллективные, за один проход по части процесса
+double density_trace(const complexd *rho, const size_t number_of_qubits);
+double density_purity(const complexd *rho, const size_t number_of_qubits);
+// <psi|rho|psi>
+double density_fidelity(const complexd *rho, const size_t number_of_qubits, const complexd *psi);
+
+#endif		//defines DENSITY_H
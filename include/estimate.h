@@ -0,0 +1,41 @@
+#ifndef ESTIMATE_H
+#define ESTIMATE_H
+
+#include "gates.h"
+
+// Стоимости ядер на одном процессе. Скорости - байты части вектора, обрабатываемые за секунду
+struct kernel_costs
+{
+	double thread_bandwidth;	// проход вентиля одним потоком
+	double memory_bandwidth;	// проход всеми потоками процесса: быстрее память не позволяет
+	double network_bandwidth;	// пересылка половины части партнеру
+	double network_latency;		// секунды на сообщение
+};
+
+// Скромные значения для узла без калибровки
+void default_costs(kernel_costs *costs);
+// Файл из строк "<имя> <значение>", как его пишет write_costs
+int read_costs(kernel_costs *costs, const char *filename);
+int write_costs(const kernel_costs *costs, const char *filename);
+// Коллективная операция: измеряет стоимости на части вектора из number_of_qubits кубитов на текущих процессах.
+// Берутся худшие по процессам значения
+int calibrate_costs(kernel_costs *costs, const size_t number_of_qubits);
+
+struct circuit_estimate
+{
+	size_t gates;
+	size_t sweeps;
+	size_t exchanges;
+	double memory_per_process;	// байты, с буфером обмена
+	double bytes_communicated;	// всеми процессами
+	double sweep_seconds;
+	double exchange_seconds;
+};
+
+void estimate_init(circuit_estimate *estimate);
+// Оценка выполнения пачки вентилей через apply_circuit_dense на processes процессах по threads потоков;
+// пачки одной схемы суммируются
+void estimate_circuit(const gate *gates, const size_t count, const size_t number_of_qubits, const int processes, const int threads,
+	const kernel_costs *costs, circuit_estimate *estimate);
+
+#endif		//defines ESTIMATE_H
@@ -29,6 +29,11 @@ extern double **adamar_matrix; // = {{1.0/sqrt(2), 1.0/sqrt(2)}, {1.0/sqrt(2), -
 int mymalloc(complexd **_portion, const size_t number_of_qubits);
 int mymalloc_f(complexd **_portion, const size_t number_of_qubits);
 void myfree(complexd *portion);
+// Карта нулевых кусков вектора: transform, two_qubit_transform, dot и norm пропускают нулевые куски,
+// а нулевые половины не пересылаются. После записи в вектор в обход библиотеки нужен zero_tracking_refresh
+int zero_tracking_attach(const complexd *portion, const size_t number_of_qubits);
+void zero_tracking_detach(const complexd *portion);
+void zero_tracking_refresh(const complexd *portion);
 void myfree_f(complexd *portion);
 int my_srand();
 int generate_state(complexd *portion, const size_t number_of_qubits);
@@ -44,9 +49,13 @@ double fidelity(const complexd *portion1, const complexd *portion2, const size_t
 double loss(const complexd *portion1, const complexd *portion2, const size_t number_of_qubits);
 // int experiment(size_t number_of_qubits, double err = 0.01, size_t number_of_cycles = 60);
 int n_adamar(complexd *portion, const size_t number_of_qubits, const double err = 0.0);
+// Приближенно нормальная случайная величина, как у шума n_adamar
+double normal();
 complexd *copy_state(complexd *copy_from, const size_t number_of_qubits);
 void functions_init(const int _myrank, const int _proc_num, const int _i_am_the_master);
 void functions_clean();
+// Коллективная: код, общий для всех процессов; процесс без своей ошибки получает NOT_SUCCESS, если она была у другого
+int collective_code(const int code);
 int read_vector_from_file(complexd *portion, size_t number_of_qubits, const char *filename);
 int write_vector_to_file(const complexd *portion, const size_t number_of_qubits, const char *filename);
 void output_vector(const complexd *portion, const size_t number_of_qubits);
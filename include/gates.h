@@ -0,0 +1,115 @@
+#ifndef GATES_H
+#define GATES_H
+
+#include "functions.h"
+#include <vector>
+
+// Кубиты нумеруются с единицы, как в transform: первый кубит - старший бит индекса.
+// Ядра работают с масками физических битов, поэтому вызывающий сам решает,
+// в каком бите лежит каждый кубит (см. gate_masks).
+enum gate_type
+{
+	GATE_H,
+	GATE_X,
+	GATE_Z,
+	GATE_RZ,		// diag(e^{-i*param/2}, e^{i*param/2})
+	GATE_RX,		// exp(-i*param/2 * X)
+	GATE_CX,		// qubits[0] - управляющий, qubits[1] - целевой
+	GATE_CP,		// diag(1, 1, 1, e^{i*param})
+	GATE_CCX,		// qubits[0], qubits[1] - управляющие, qubits[2] - целевой
+	GATE_SWAP,
+	GATE_MEASURE
+};
+
+#define GATE_MAX_QUBITS 3
+
+struct gate
+{
+	unsigned char type;
+	unsigned char qubits_num;
+	unsigned short qubits[GATE_MAX_QUBITS];
+	double param;
+};
+
+gate make_gate1(const int type, const size_t q1, const double param = 0.0);
+gate make_gate2(const int type, const size_t q1, const size_t q2, const double param = 0.0);
+gate make_gate3(const int type, const size_t q1, const size_t q2, const size_t q3);
+
+// Вентиль не меняет модулей амплитуд и не переставляет их
+bool gate_is_diagonal(const gate &g);
+// На кубите q вентиль только меняет фазы или служит управляющим: такие вентили коммутируют на нем
+bool gate_is_diagonal_on(const gate &g, const size_t q);
+// Маски кубитов вентиля; bit_of[q] - физический бит кубита q (NULL - бит number_of_qubits - q)
+void gate_masks(const gate &g, const size_t number_of_qubits, const int *bit_of, ulong *masks);
+// Биты, между которыми вентиль перемешивает амплитуды: они должны лежать внутри обрабатываемого блока
+ulong gate_target_mask(const gate &g, const ulong *masks);
+
+// Вставляет нулевой бит на место mask: пробегая i от 0 до size/2, получаем все индексы с нулем в этом бите
+inline ulong insert_zero(const ulong i, const ulong mask)
+{
+	ulong low = i & (mask - 1);
+	return ((i - low) << 1) | low;
+}
+// Номер старшего установленного бита v (0 для v = 0)
+size_t log2_of(ulong v);
+
+// Применяет вентиль к непрерывному куску вектора длины block_size (степень двойки),
+// первый элемент которого имеет глобальный индекс first_index.
+// Целевые биты должны быть меньше block_size, управляющие могут быть любыми.
+// states > 1 - кусок пачки векторов: у каждого индекса states амплитуд подряд
+int apply_gate_block(complexd *block, const ulong block_size, const ulong first_index, const gate &g, const ulong *masks, const size_t states = 1);
+
+#define LAYOUT_MAX_QUBITS 64
+
+// Расположение кубитов по битам индекса распределенного вектора: bit_of[q] - бит кубита q,
+// qubit_at[b] - кубит в бите b. Биты от local_bits и выше - номер процесса
+// (у вектора вне памяти local_bits - биты внутри блока)
+struct qubit_layout
+{
+	size_t number_of_qubits;
+	size_t local_bits;
+	int bit_of[LAYOUT_MAX_QUBITS + 1];
+	int qubit_at[LAYOUT_MAX_QUBITS];
+};
+
+// Исходное расположение: кубит q в бите number_of_qubits - q
+void layout_init(qubit_layout *layout, const size_t number_of_qubits, const ulong portion_size);
+void layout_swap(qubit_layout *layout, const int bit1, const int bit2);
+// Целевые биты вентиля при этом расположении
+ulong layout_target_mask(const qubit_layout *layout, const gate &g);
+// Локальный бит не из busy, кубит которого дольше всех не понадобится схеме gates как целевой; -1 если таких нет
+int layout_victim(const qubit_layout *layout, const gate *gates, const size_t count, const ulong busy);
+
+// log2 размера куска, по которому apply_circuit_dense применяет подряд идущие вентили за один проход
+#define DENSE_CACHE_BITS 14
+// Размер куска (в индексах) для части процесса размера portion_size; равен части, если группы не собираются
+ulong dense_cache_size(const ulong portion_size, const size_t states = 1);
+
+// Выполняет схему на распределенном векторе. Глобальный целевой бит меняется местами с локальным, кубит которого
+// дольше всех не понадобится, и остается там до конца схемы; в конце исходное расположение восстанавливается.
+// Если по оценке dense_circuit_cost дешевле возвращать бит на место сразу после вентиля, так и делается.
+// Подряд идущие вентили с целевыми битами внутри куска DENSE_CACHE_BITS применяются за один проход по памяти.
+// Результат измерения с классическим битом k записывается в (*bits)[k]
+int apply_circuit_dense(complexd *portion, const size_t number_of_qubits, const gate *gates, const size_t count, std::vector<int> *bits = NULL);
+// То же для пачки из states векторов, хранящихся вперемешку: амплитуда i вектора s лежит в portion[i*states + s].
+// Каждое ядро обрабатывает все векторы индекса за одно чтение, обмен пересылает все векторы одним сообщением.
+// Измерение не поддерживается
+int apply_circuit_batch(complexd *portion, const size_t states, const size_t number_of_qubits, const gate *gates, const size_t count);
+// Пачка по частям схемы с расположением кубитов, которое ведет вызывающий: выполнение начинается с *layout,
+// перенесенные в локальные биты кубиты там и остаются. В конце нужен batch_restore_layout
+int apply_circuit_batch_from(complexd *portion, const size_t states, qubit_layout *layout, const gate *gates, const size_t count);
+// Переносит глобальный кубит qubit в локальный бит, кубит которого дольше всех не понадобится схеме upcoming
+int batch_localize_qubit(complexd *portion, const size_t states, qubit_layout *layout, const size_t qubit, const gate *upcoming, const size_t count);
+// Возвращает кубиты пачки на исходные места
+int batch_restore_layout(complexd *portion, const size_t states, qubit_layout *layout);
+// Проходы по части вектора и обмены половинами части, которые сделает apply_circuit_dense на processes процессах
+void dense_circuit_cost(const gate *gates, const size_t count, const size_t number_of_qubits, const int processes, size_t *sweeps, size_t *exchanges);
+// Зерно генератора исходов измерений; без него генератор засевается rand() при первом измерении
+void measurement_seed(const ulong seed);
+// Следующее равномерное число из [0, 1) этого генератора; вызывается только на рутовом процессе
+double measurement_uniform();
+
+// QFT в том же порядке вентилей, что и qft_transform
+void qft_circuit(const size_t number_of_qubits, std::vector<gate> &gates);
+
+#endif		//defines GATES_H
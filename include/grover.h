@@ -0,0 +1,29 @@
+#ifndef GROVER_H
+#define GROVER_H
+
+#include "gates.h"
+#include <vector>
+
+// Шаг Гровера без разложения на вентили: оракул меняет знак помеченных амплитуд,
+// диффузия H^n (2|0><0| - I) H^n - это отражение относительно среднего a -> 2*mean - a.
+// Шаг стоит двух проходов по части вектора и одного MPI_Allreduce
+
+// Помечен ли базисный вектор с глобальным индексом index
+typedef bool (*grover_predicate)(const ulong index, void *arg);
+
+// Оракул задается списком индексов (по возрастанию) или предикатом, если predicate не NULL
+struct grover_oracle
+{
+	std::vector<ulong> marked;
+	grover_predicate predicate;
+	void *arg;
+};
+
+// Коллективная: iterations шагов над частью вектора
+int grover_iterate(complexd *portion, const size_t number_of_qubits, const grover_oracle *oracle, const size_t iterations);
+// Коллективная: суммарная вероятность помеченных состояний
+double grover_marked_probability(const complexd *portion, const size_t number_of_qubits, const grover_oracle *oracle);
+// Число шагов с наибольшей вероятностью успеха для marked помеченных из 2^n: round(pi / (4 * asin(sqrt(marked / 2^n))) - 1/2)
+size_t grover_optimal_iterations(const size_t number_of_qubits, const ulong marked);
+
+#endif		//defines GROVER_H
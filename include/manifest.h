@@ -0,0 +1,30 @@
+#ifndef MANIFEST_H
+#define MANIFEST_H
+
+#include "functions.h"
+#include <string>
+#include <vector>
+
+// Задание манифеста: строка "<файл> ... <файл> <number_of_qubits>", число файлов задает утилита
+// (generate: выходной; view: входной; fidelity: два входных; solve: входной, выходной и, возможно, схема)
+struct manifest_job
+{
+	std::vector<std::string> files;
+	size_t number_of_qubits;
+};
+
+// Пустые строки и строки, начинающиеся с '#', пропускаются. После files_num обязательных файлов
+// может идти еще до optional_files необязательных
+int read_manifest(const char *filename, const size_t files_num, std::vector<manifest_job> &jobs, const size_t optional_files = 0);
+
+// Обработка задания: vectors - буферы под части векторов задания, первые inputs из них уже прочитаны
+// из первых inputs файлов задания. Вызывается всеми процессами, может выполнять коллективные операции
+typedef int (*manifest_job_function)(const manifest_job &job, complexd **vectors, void *arg);
+
+// Выполняет задания по порядку в одном запуске MPI. Буферы выделяются один раз под наибольшее задание
+// и переиспользуются; пока обрабатывается задание k, в другой набор буферов читаются входы задания k + 1.
+// Останавливается на первой ошибке
+int manifest_run(const std::vector<manifest_job> &jobs, const size_t inputs, const size_t vectors,
+	manifest_job_function process, void *arg);
+
+#endif		//defines MANIFEST_H
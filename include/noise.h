@@ -0,0 +1,40 @@
+#ifndef NOISE_H
+#define NOISE_H
+
+#include "gates.h"
+
+// Шум после каждого вентиля на каждом его кубите, как ошибка поворота в n_adamar, но независимо для каждого вентиля:
+//  - rotation: поворот [[cos t, sin t], [-sin t, cos t]] на угол t = normal() * rotation;
+//  - depolarizing: с этой вероятностью X, Y или Z (равновероятно);
+//  - damping: затухание амплитуды с вероятностью gamma методом квантовых скачков:
+//    скачок |1> -> |0> с вероятностью gamma * P(1), иначе амплитуда |1> умножается на sqrt(1 - gamma); вектор нормируется
+struct noise_model
+{
+	double rotation;
+	double depolarizing;
+	double damping;
+};
+
+// Накопленная статистика точности траекторий (метод Уэлфорда)
+struct noise_statistics
+{
+	size_t trajectories;
+	double mean;
+	double m2;
+	double min;
+};
+
+void noise_statistics_init(noise_statistics *stats);
+double noise_statistics_std(const noise_statistics *stats);
+
+// Коллективная: states траекторий за один проход. Каждая траектория начинается с части вектора start,
+// к ней применяются вентили gates с шумом model, точность |<ideal|psi>|^2 добавляется в stats.
+// Траектории хранятся вперемешку (см. apply_circuit_batch): вентили схемы применяются ко всем сразу,
+// шумовые матрицы у каждой траектории свои. Шум на кубите коммутирует с вентилями на других кубитах, поэтому
+// откладывается до следующего вентиля на этом кубите: вентили между ними выполняются одним apply_circuit_batch_from.
+// Расположение кубитов сохраняется между отрезками; глобальный кубит для шума переносится в локальный бит и остается там.
+// Случайные числа берет рутовый процесс. Измерение не поддерживается
+int run_trajectories(const complexd *start, const complexd *ideal, const size_t number_of_qubits, const gate *gates, const size_t count,
+	const noise_model *model, const size_t states, noise_statistics *stats);
+
+#endif		//defines NOISE_H
@@ -0,0 +1,33 @@
+#ifndef OBSERVE_H
+#define OBSERVE_H
+
+#include "gates.h"
+#include <string>
+#include <vector>
+
+// Наблюдения над распределенным вектором, не меняющие его. Все функции коллективные
+
+// shots индексов базисных состояний, выбранных с вероятностями |amplitude|^2 (вектор может быть не нормирован).
+// Случайные числа берет рутовый процесс из генератора исходов измерений (воспроизводимы при --seed),
+// результат одинаков на всех процессах и упорядочен по возрастанию
+int sample_state(const complexd *portion, const size_t number_of_qubits, const size_t shots, std::vector<ulong> &samples);
+
+// Четность числа единиц в v: знак (-1)^{|i & z_mask|} множителя Z строки Паули
+inline int parity(ulong v)
+{
+	int shift;
+	for(shift = 32; shift > 0; shift /= 2)
+		v ^= v >> shift;
+	return v & 1;
+}
+
+// <psi|P|psi> для строки Паули из number_of_qubits символов I, X, Y, Z; символ k относится к кубиту k+1.
+// Если P переставляет глобальные биты, процесс обменивается частью с партнером
+int pauli_expectation(const complexd *portion, const size_t number_of_qubits, const std::string &paulis, double *value);
+
+// Амплитуды выхода qft_transform с индексами indices, посчитанные по входному вектору без преобразования:
+// амплитуда m равна (1/sqrt(N)) * sum_j x_j * e^{2*pi*i*j*k/N}, где k - m с обратным порядком битов.
+// Все запросы считаются за один проход по части вектора, результат одинаков на всех процессах
+int qft_amplitudes(const complexd *portion, const size_t number_of_qubits, const std::vector<ulong> &indices, std::vector<complexd> &amplitudes);
+
+#endif		//defines OBSERVE_H
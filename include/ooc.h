@@ -0,0 +1,69 @@
+#ifndef OOC_H
+#define OOC_H
+
+#include "gates.h"
+#include <string>
+#include <sys/types.h>
+
+// Хранилище блоков части вектора, принадлежащей процессу.
+// load и store могут вызываться одновременно из разных потоков для разных блоков.
+class block_storage
+{
+public:
+	virtual ~block_storage() {}
+	virtual int load(const ulong block_num, complexd *buffer) = 0;
+	virtual int store(const ulong block_num, const complexd *buffer) = 0;
+};
+
+// Часть вектора лежит в файле <prefix>.<myrank> на локальном диске
+class file_storage: public block_storage
+{
+	int fd;
+	ulong block_size;
+	std::string path;
+public:
+	file_storage(): fd(-1), block_size(0) {}
+	~file_storage();
+	int open(const char *prefix, const ulong portion_size, const ulong _block_size);
+	void close(const bool remove_file = true);
+	int load(const ulong block_num, complexd *buffer);
+	int store(const ulong block_num, const complexd *buffer);
+};
+
+// pread и pwrite могут вернуть меньше запрошенного, поэтому повторяем до конца
+int full_pread(const int fd, void *buffer, const size_t bytes, const off_t offset);
+int full_pwrite(const int fd, const void *buffer, const size_t bytes, const off_t offset);
+
+#define BLOCKED_MAX_QUBITS 64
+
+// Вектор, обрабатываемый по блокам: в памяти одновременно находятся лишь несколько блоков.
+// Кубиты переезжают между физическими битами индекса, чтобы целевые биты вентилей попадали внутрь блока.
+struct blocked_state
+{
+	size_t number_of_qubits;
+	size_t local_bits;		// log2 размера части процесса
+	size_t block_bits;		// log2 размера блока
+	ulong portion_size;
+	ulong block_size;
+	ulong blocks_num;
+	qubit_layout layout;	// физические биты кубитов; local_bits раскладки - block_bits
+	block_storage *storage;
+	complexd *buffers;
+	// статистика
+	ulong passes;
+	ulong swaps;
+};
+
+// Наибольший размер блока, при котором буферы прохода укладываются в memory_mb мегабайт
+ulong blocked_block_size(const size_t number_of_qubits, const size_t memory_mb);
+int blocked_init(blocked_state *state, const size_t number_of_qubits, block_storage *storage, const ulong block_size);
+void blocked_clean(blocked_state *state);
+// Каждый процесс сам читает и пишет свою часть файла вектора, по блоку за раз
+int blocked_read_vector_from_file(blocked_state *state, const char *filename);
+int blocked_write_vector_to_file(blocked_state *state, const char *filename);
+// Подряд идущие вентили с целевыми битами внутри блока применяются за один проход по хранилищу
+int blocked_apply_circuit(blocked_state *state, const gate *gates, const size_t count);
+// Возвращает каждый кубит в его исходный бит
+int blocked_restore_layout(blocked_state *state);
+
+#endif		//defines OOC_H
@@ -0,0 +1,36 @@
+#ifndef OPTIMIZE_H
+#define OPTIMIZE_H
+
+#include "gates.h"
+#include <vector>
+
+// Стоимость схемы для apply_circuit_dense: проходы по части вектора и обмены половинами части (см. dense_circuit_cost)
+struct circuit_cost
+{
+	size_t gates;
+	size_t sweeps;
+	size_t exchanges;
+};
+
+// Стоимость на processes процессах прибавляется к *cost
+void estimate_cost(const gate *gates, const size_t count, const size_t number_of_qubits, const int processes, circuit_cost *cost);
+
+// Стоимости до и после оптимизации; при оптимизации по пачкам накапливаются
+struct optimize_report
+{
+	circuit_cost before;
+	circuit_cost after;
+};
+
+void optimize_report_init(optimize_report *report);
+
+// Упрощает схему, не меняя результата (включая глобальную фазу):
+//  - взаимно обратные соседние вентили (H H, X X, Z Z, CX CX, CCX CCX, SWAP SWAP) удаляются;
+//  - соседние повороты RX по одному кубиту складываются;
+//  - диагональные вентили (Z, RZ, CP) переносятся через вентили, действующие на их кубиты диагонально
+//    (другие диагональные и управляющие кубиты CX, CCX), и складываются с такими же;
+//  - однокубитные вентили поглощаются соседями: H X H -> Z, H Z H -> X, X RZ(a) X -> RZ(-a).
+// Проходы повторяются, пока схема уменьшается. Измерение ни с чем не переставляется
+void optimize_circuit(std::vector<gate> &gates, const size_t number_of_qubits, optimize_report *report = NULL);
+
+#endif		//defines OPTIMIZE_H
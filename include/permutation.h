@@ -0,0 +1,30 @@
+#ifndef PERMUTATION_H
+#define PERMUTATION_H
+
+#include "gates.h"
+
+// Классические обратимые оракулы: перестановка базисных состояний, амплитуда индекса i переходит в f(i).
+// f должна быть биекцией на [0, 2^n) и вызываться из нескольких потоков одновременно
+typedef ulong (*permutation_function)(const ulong index, void *arg);
+
+// Коллективная. Первый проход считает, сколько амплитуд уходит каждому процессу. Если на всех процессах
+// перестановка не выходит за пределы части, она выполняется на месте обходом циклов (с битовой картой
+// пройденных индексов); иначе - копированием в новую часть: свои амплитуды пишутся сразу, чужие пары
+// (индекс, амплитуда) рассылаются одним MPI_Alltoallv, как в sparse. f вычисляется дважды на индекс
+int apply_permutation(complexd *portion, const size_t number_of_qubits, permutation_function f, void *arg);
+
+// |x>|y> -> |x>|y * a^x mod N> при y < N, остальные y не меняются; x - первые x_qubits кубитов.
+// Биекция при НОД(a, N) = 1 и N <= 2^(n - x_qubits)
+struct modexp_oracle
+{
+	size_t y_bits;
+	ulong modulus;
+	std::vector<ulong> powers;	// a^(2^k) mod N
+};
+int modexp_oracle_init(modexp_oracle *oracle, const size_t number_of_qubits, const ulong a, const ulong modulus, const size_t x_qubits);
+ulong modexp_permutation(const ulong index, void *arg);
+
+// |i> -> |i + shift mod 2^n>, arg - указатель на пару { shift, 2^n - 1 }
+ulong add_permutation(const ulong index, void *arg);
+
+#endif		//defines PERMUTATION_H
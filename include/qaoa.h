@@ -0,0 +1,43 @@
+#ifndef QAOA_H
+#define QAOA_H
+
+#include "gates.h"
+#include <vector>
+
+// QAOA для MaxCut: вершины графа - кубиты 1..n, C(x) - суммарный вес ребер между вершинами с разными битами
+
+struct qaoa_edge
+{
+	unsigned short u;
+	unsigned short v;
+	double weight;
+};
+
+struct qaoa_graph
+{
+	std::vector<qaoa_edge> edges;
+	// все веса целые неотрицательные: C(x) - целое не больше total_weight, фазы берутся из таблицы,
+	// если total_weight меньше части вектора
+	bool integral;
+	double total_weight;
+};
+
+// Строки "u v [weight]" с вершинами 1..number_of_qubits, вес по умолчанию 1; # - комментарий. Читает каждый процесс
+int read_graph(const char *filename, const size_t number_of_qubits, qaoa_graph *graph);
+
+// Результат QAOA
+struct qaoa_result
+{
+	double expectation;			// <C>
+	double max_cut;				// max C(x) по всем x
+	double max_cut_probability;	// вероятность получить разрез max_cut
+};
+
+// Коллективная: слои exp(-i*gamma[k]*C), затем смеситель exp(-i*beta[k]*sum X) для k = 0..layers-1.
+// Слой стоимости диагональный и обходится без обменов: C считается по битам индекса для каждого ребра,
+// или один раз в таблицу, если часть таблицы не больше QAOA_TABLE_BYTES. Смеситель - слой RX(2*beta)
+// через apply_circuit_dense. <C>, максимальный разрез и его вероятность - в одном заключительном проходе
+int qaoa_run(complexd *portion, const size_t number_of_qubits, const qaoa_graph *graph, const std::vector<double> &gammas,
+	const std::vector<double> &betas, qaoa_result *result);
+
+#endif		//defines QAOA_H
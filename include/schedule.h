@@ -0,0 +1,15 @@
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#include "optimize.h"
+#include <vector>
+
+// Переупорядочивает схему по графу зависимостей. Вентиль зависит от предыдущего, если у них есть общий кубит,
+// на котором хотя бы один из них не диагонален (диагональные вентили и управляющие кубиты коммутируют).
+// Из готовых вентилей сначала выполняются те, чьи целевые кубиты лежат в куске dense_cache_size,
+// затем остальные локальные, и лишь когда таких нет - вентиль, глобальные целевые кубиты которого
+// нужны наибольшему числу готовых вентилей. Новый порядок принимается, только если apply_circuit_dense
+// на processes процессах сделает с ним не больше обменов и проходов по памяти
+void schedule_circuit(std::vector<gate> &gates, const size_t number_of_qubits, const int processes, optimize_report *report = NULL);
+
+#endif		//defines SCHEDULE_H
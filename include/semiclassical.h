@@ -0,0 +1,18 @@
+#ifndef SEMICLASSICAL_H
+#define SEMICLASSICAL_H
+
+#include "gates.h"
+
+// Полуклассическое QFT (Гриффитс - Ниу) с измерением выхода: кубиты qft_circuit обрабатываются по порядку,
+// кубит q после адамара сразу измеряется, и его CP с последующими кубитами становятся классически управляемыми
+// фазами. Фазы всех измеренных кубитов на кубите q складываются в одну, итого n однокубитных шагов
+// (фаза, адамар и измерение за один проход) вместо n(n-1)/2 CP.
+// Кубит q - старший бит еще не измеренной части, поэтому после каждого измерения активный отрезок вектора
+// сжимается вдвое: пока он шире части процесса, пары процессов пересылают половины кусками по
+// SEMICLASSICAL_CHUNK, отброшенные процессы выходят из работы; дальше работает только процесс с отрезком
+
+// Коллективная. outcome - индекс выхода в порядке qft_transform (кубит 1 - старший бит), probability - его вероятность.
+// Исходы выбирает measurement_uniform на рутовом процессе. На выходе вектор - базисное состояние outcome
+int semiclassical_qft(complexd *portion, const size_t number_of_qubits, ulong *outcome, double *probability);
+
+#endif		//defines SEMICLASSICAL_H
@@ -0,0 +1,20 @@
+#ifndef SERVE_H
+#define SERVE_H
+
+#include "functions.h"
+
+// Вектор из number_of_qubits кубитов остается в памяти процессов, команды приходят построчно
+// через Unix-сокет socket_path (клиенты подключаются по одному). Рутовый процесс читает команду
+// и рассылает ее остальным, отвечает клиенту строками результата и строкой "OK" или "ERROR <код>":
+//   load <file>         прочитать вектор из файла
+//   reset               |0...0>
+//   apply <file.qasm>   выполнить схему (с упрощением и переупорядочиванием, если optimize);
+//                       измеренные биты выводятся строкой "c = <биты>"
+//   sample <shots>      строки "<биты кубитов 1..n> <число выпадений>"
+//   expect <paulis>     <psi|P|psi> для строки из I, X, Y, Z
+//   snapshot <file>     записать вектор в файл
+//   quit                закрыть соединение
+//   shutdown            остановить сервер
+int serve(const char *socket_path, const size_t number_of_qubits, const bool optimize);
+
+#endif		//defines SERVE_H
@@ -0,0 +1,39 @@
+#ifndef SHM_H
+#define SHM_H
+
+#include "functions.h"
+
+// Вектор в разделяемой памяти POSIX: сегмент /<name> - заголовок, /<name>.data - все 2^n амплитуд подряд.
+// solve считает прямо в сегменте, а view и fidelity отображают свою часть и читают амплитуды без копирования.
+// Все процессы должны работать на одном узле. Сегменты остаются после выхода, удалить их можно
+// через shm_remove или из /dev/shm
+
+#define SHM_MAGIC 0x51534d31
+
+struct shm_header
+{
+	unsigned int magic;
+	unsigned int ready;				// 1, когда все процессы записали свои части
+	unsigned long number_of_qubits;
+	int processes;					// сколько процессов записали вектор
+};
+
+// Отображение части вектора процесса; base и length - выровненная по странице область для munmap
+struct shm_portion
+{
+	void *base;
+	size_t length;
+	complexd *portion;
+};
+
+// Коллективная: создает сегменты заново (старые с тем же именем удаляются) и отображает часть процесса для записи
+int shm_create(const char *name, const size_t number_of_qubits, shm_portion *mapping);
+// Коллективная: помечает вектор готовым и отключается от него; сегменты остаются для инструментов
+int shm_publish(const char *name, shm_portion *mapping);
+// Коллективная: читает заголовок готового вектора и отображает часть процесса только для чтения
+int shm_attach(const char *name, size_t *number_of_qubits, shm_portion *mapping);
+void shm_detach(shm_portion *mapping);
+// Вызывается одним процессом
+int shm_remove(const char *name);
+
+#endif		//defines SHM_H
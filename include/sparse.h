@@ -0,0 +1,64 @@
+#ifndef SPARSE_H
+#define SPARSE_H
+
+#include "gates.h"
+#include <vector>
+
+#define SPARSE_EMPTY (~0UL)
+
+// Индекс и амплитуда; в таком виде элементы пересылаются между процессами
+struct sparse_entry
+{
+	ulong index;
+	complexd value;
+};
+
+// Хеш-таблица с открытой адресацией и линейным пробированием: индекс -> амплитуда
+class sparse_map
+{
+	std::vector<ulong> keys;
+	std::vector<complexd> values;
+	ulong count;
+	void grow();
+public:
+	sparse_map(): count(0) {}
+	// прибавляет value к амплитуде index
+	void add(const ulong index, const complexd value);
+	complexd get(const ulong index) const;
+	void clear();
+	// удаляет амплитуды с модулем меньше eps
+	void prune(const double eps);
+	ulong size() const { return count; }
+	ulong capacity() const { return keys.size(); }
+	bool used(const ulong slot) const { return keys[slot] != SPARSE_EMPTY; }
+	ulong key(const ulong slot) const { return keys[slot]; }
+	complexd &value(const ulong slot) { return values[slot]; }
+	const complexd &value(const ulong slot) const { return values[slot]; }
+};
+
+// Разреженный вектор: ненулевые амплитуды распределены по процессам по хешу индекса
+struct sparse_state
+{
+	size_t number_of_qubits;
+	sparse_map amplitudes;
+};
+
+// Процесс, хранящий амплитуду index
+int sparse_owner(const ulong index);
+int sparse_init(sparse_state *state, const size_t number_of_qubits);
+// Базисное состояние |index>
+int sparse_set_basis(sparse_state *state, const ulong index);
+// Число ненулевых амплитуд на всех процессах
+ulong sparse_count(const sparse_state *state);
+double sparse_norm(const sparse_state *state);
+// Применяет вентили к ненулевым амплитудам. Когда доля ненулевых превышает promote_density,
+// вектор переводится в обычное распределенное представление: *portion указывает на него,
+// оставшиеся вентили применяются к нему. Иначе *portion == NULL
+int sparse_apply_circuit(sparse_state *state, const gate *gates, const size_t count, const double promote_density, complexd **portion);
+// Переводит разреженный вектор в обычный: portion выделен mymalloc
+int sparse_to_dense(sparse_state *state, complexd *portion);
+// Файлы того же формата, что и у read_vector_from_file: каждый процесс читает и пишет свою часть файла
+int sparse_read_vector_from_file(sparse_state *state, const char *filename);
+int sparse_write_vector_to_file(const sparse_state *state, const char *filename);
+
+#endif		//defines SPARSE_H
@@ -0,0 +1,43 @@
+#ifndef STABILIZER_H
+#define STABILIZER_H
+
+#include "gates.h"
+#include <vector>
+
+// Клиффордово начало схемы на таблице стабилизаторов (Ааронсон - Готтесман без дестабилизаторов):
+// O(n^2) на вентиль вместо прохода по 2^n амплитудам. Бит кубита q в масках - бит n - q индекса, как в векторе
+// (поэтому не больше 64 кубитов)
+
+// Оператор Паули i^phase * X^x * Z^z (на каждом кубите сначала X, потом Z)
+struct pauli_row
+{
+	ulong x;
+	ulong z;
+	int phase;
+};
+
+// Состояние задано n порождающими стабилизаторами с точностью до глобальной фазы; саму фазу дает
+// одна ненулевая амплитуда amplitude = <reference|psi>, которая ведется вместе с таблицей
+struct stabilizer_state
+{
+	size_t number_of_qubits;
+	std::vector<pauli_row> rows;
+	ulong reference;
+	complexd amplitude;
+};
+
+// Вентиль клиффордов: H, X, Z, CX, SWAP, CP с углом, кратным pi, RZ и RX с углом, кратным pi/2.
+// Измерение таблицей не выполняется
+bool is_clifford(const gate &g);
+// amplitude * |index>
+void stabilizer_set_basis(stabilizer_state *state, const size_t number_of_qubits, const ulong index, const complexd amplitude);
+// Коллективная: если у части вектора ровно одна ненулевая амплитуда на всех процессах, *basis = true
+// и state - это базисное состояние с той же амплитудой
+int stabilizer_from_vector(stabilizer_state *state, const complexd *portion, const size_t number_of_qubits, bool *basis);
+// Применяет вентили до первого неклиффордова; *applied - сколько применено
+void stabilizer_apply_circuit(stabilizer_state *state, const gate *gates, const size_t count, size_t *applied);
+// Каждый процесс пишет свою часть прямо из таблицы: носитель состояния - reference + линейная оболочка
+// X-частей стабилизаторов, амплитуды перебираются кодом Грея по строкам с локальными ведущими битами
+void stabilizer_to_dense(const stabilizer_state *state, complexd *portion);
+
+#endif		//defines STABILIZER_H
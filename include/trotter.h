@@ -0,0 +1,69 @@
+#ifndef TROTTER_H
+#define TROTTER_H
+
+#include "observe.h"
+#include <string>
+#include <vector>
+
+// Гамильтониан - сумма слагаемых coefficient * P, P - строка Паули как в pauli_expectation
+struct pauli_term
+{
+	double coefficient;
+	std::string paulis;
+};
+
+// Строки "coefficient PAULIS"; # - комментарий. Читает каждый процесс
+int read_hamiltonian(const char *filename, const size_t number_of_qubits, std::vector<pauli_term> &terms);
+
+// Только I и Z: слагаемое диагонально в вычислительном базисе
+bool is_diagonal(const pauli_term &term);
+
+// Диагональная часть гамильтониана: sum c_k * (-1)^{|i & z_mask_k|}
+struct diagonal_part
+{
+	std::vector<ulong> z_masks;
+	std::vector<double> coefficients;
+};
+
+// Диагональные слагаемые terms - в diagonal, остальные - в others (если не NULL)
+void split_diagonal(const std::vector<pauli_term> &terms, const size_t number_of_qubits, diagonal_part *diagonal,
+	std::vector<pauli_term> *others);
+// Значение диагональной части на базисном состоянии index
+inline double diagonal_value(const diagonal_part *diagonal, const ulong index)
+{
+	const size_t terms = diagonal->z_masks.size();
+	const ulong *masks = diagonal->z_masks.data();
+	const double *coefficients = diagonal->coefficients.data();
+	double value = 0;
+	size_t k;
+	for(k = 0; k < terms; k++)
+		value += parity(index & masks[k]) ? -coefficients[k] : coefficients[k];
+	return value;
+}
+
+struct trotter_options
+{
+	double time;
+	size_t steps;
+	int order;							// 1: D N на шаге, 2: D/2 N D/2 (соседние половины D сливаются)
+	std::vector<std::string> observables;	// строки Паули, измеряемые каждые observe_every шагов
+	size_t observe_every;				// 0 - только в конце
+};
+
+// Значения наблюдаемых после step шагов
+struct trotter_sample
+{
+	size_t step;
+	double time;
+	std::vector<double> values;
+};
+
+// Коллективная: exp(-i*H*time) шагами Троттера. Диагональные слагаемые (только I и Z) всего шага -
+// один проход по части вектора без обменов, фаза считается по битам индекса. Остальные слагаемые
+// переводятся в вентили (смена базиса, лестница CX, RZ) один раз, упрощаются optimize_circuit
+// и выполняются apply_circuit_dense как слои; одиночные X - сразу RX. При order 2 некоммутирующие
+// недиагональные слагаемые идут симметрично. Наблюдаемые считаются pauli_expectation по самому вектору
+int trotter_evolve(complexd *portion, const size_t number_of_qubits, const std::vector<pauli_term> &terms,
+	const trotter_options *options, std::vector<trotter_sample> &samples);
+
+#endif		//defines TROTTER_H
@@ -0,0 +1,138 @@
+#include "adjoint.h"
+
+#include <cmath>
+#include <stdio.h>
+
+static const double pi = std::acos(-1);
+
+bool gate_has_parameter(const gate &g)
+{
+	return g.type == GATE_RX || g.type == GATE_RZ || g.type == GATE_CP;
+}
+
+static gate inverse_gate(const gate &g)
+{
+	gate result = g;
+	if(gate_has_parameter(g))
+		result.param = -g.param;
+	return result;
+}
+
+// lambda += factor * psi
+static void add_scaled(complexd *lambda, const complexd *psi, const ulong portion_size, const complexd factor)
+{
+	long i;
+	const long size = portion_size;
+	#pragma omp parallel for
+	for(i = 0; i < size; i++)
+		lambda[i] += factor * psi[i];
+}
+
+int apply_hamiltonian(complexd *psi, complexd *lambda, const size_t number_of_qubits, const std::vector<pauli_term> &terms)
+{
+	const ulong portion_size = (1UL << number_of_qubits) / proc_num;
+	const ulong first = myrank * portion_size;
+	// диагональные слагаемые - один проход, как в trotter_evolve
+	diagonal_part diagonal;
+	split_diagonal(terms, number_of_qubits, &diagonal, NULL);
+	size_t k, q;
+	long i;
+	const long size = portion_size;
+	#pragma omp parallel for
+	for(i = 0; i < size; i++)
+		lambda[i] = diagonal_value(&diagonal, first + i) * psi[i];
+	// остальные: P psi вентилями X и Z (Y = i X Z), добавление к lambda и снятие вентилей
+	int code = SUCCESS;
+	std::vector<gate> paulis;
+	for(k = 0; k < terms.size() && code == SUCCESS; k++)
+	{
+		if(is_diagonal(terms[k]))
+			continue;
+		paulis.clear();
+		size_t ny = 0;
+		for(q = 0; q < number_of_qubits; q++)
+		{
+			const char p = terms[k].paulis[q];
+			if(p == 'Z' || p == 'Y')
+				paulis.push_back(make_gate1(GATE_Z, q + 1));
+			if(p == 'X' || p == 'Y')
+				paulis.push_back(make_gate1(GATE_X, q + 1));
+			ny += p == 'Y';
+		}
+		const complexd i_powers[4] = { 1, complexd(0, 1), -1, complexd(0, -1) };
+		code = apply_circuit_dense(psi, number_of_qubits, paulis.data(), paulis.size());
+		if(code == SUCCESS)
+		{
+			add_scaled(lambda, psi, portion_size, terms[k].coefficient * i_powers[ny % 4]);
+			// X и Z самообратны, снимаются в обратном порядке
+			std::vector<gate> undo(paulis.rbegin(), paulis.rend());
+			code = apply_circuit_dense(psi, number_of_qubits, undo.data(), undo.size());
+		}
+	}
+	return code;
+}
+
+int adjoint_gradients(complexd *psi, complexd *lambda, const size_t number_of_qubits, const gate *gates, const size_t count,
+	const std::vector<pauli_term> &terms, double *energy, std::vector<double> &gradients)
+{
+	size_t k, parameters = 0;
+	for(k = 0; k < count; k++)
+	{
+		if(gates[k].type == GATE_MEASURE) {
+			if(i_am_the_master)
+				fprintf(stderr, "%s\n", "Measurement is not supported in adjoint gradients");
+			return WRONG_VALUE;
+		}
+		parameters += gate_has_parameter(gates[k]);
+	}
+	gradients.assign(parameters, 0.0);
+	int code = apply_circuit_dense(psi, number_of_qubits, gates, count);
+	if(code == SUCCESS)
+		code = apply_hamiltonian(psi, lambda, number_of_qubits, terms);
+	if(code != SUCCESS)
+		return code;
+	*energy = dot(lambda, psi, number_of_qubits).real();
+	// вентили, которые еще предстоит применить к psi и lambda: снятые вентили копятся и идут одним вызовом
+	std::vector<gate> psi_pending, lambda_pending;
+	for(k = count; k > 0 && code == SUCCESS; k--)
+	{
+		const gate &g = gates[k - 1];
+		if(!gate_has_parameter(g))
+		{
+			psi_pending.push_back(inverse_gate(g));
+			lambda_pending.push_back(inverse_gate(g));
+			continue;
+		}
+		// генератор: dU/dt = -i/2 X U для RX, -i/2 Z U для RZ, i |11><11| U для CP
+		gate generator;
+		if(g.type == GATE_RX)
+			generator = make_gate1(GATE_X, g.qubits[0]);
+		else if(g.type == GATE_RZ)
+			generator = make_gate1(GATE_Z, g.qubits[0]);
+		else
+			generator = make_gate2(GATE_CP, g.qubits[0], g.qubits[1], pi);
+		code = apply_circuit_dense(lambda, number_of_qubits, lambda_pending.data(), lambda_pending.size());
+		complexd overlap_without = 0;
+		if(code == SUCCESS && g.type == GATE_CP)
+		{
+			code = apply_circuit_dense(psi, number_of_qubits, psi_pending.data(), psi_pending.size());
+			psi_pending.clear();
+			overlap_without = dot(psi, lambda, number_of_qubits);
+		}
+		psi_pending.push_back(generator);
+		if(code == SUCCESS)
+			code = apply_circuit_dense(psi, number_of_qubits, psi_pending.data(), psi_pending.size());
+		// dot(a, b) = <b|a>
+		const complexd overlap = dot(psi, lambda, number_of_qubits);
+		parameters--;
+		if(g.type == GATE_CP)
+			// <lambda|P11 psi> = (<lambda|psi> - <lambda|CZ psi>) / 2, производная -2 Im
+			gradients[parameters] = -(overlap_without - overlap).imag();
+		else
+			gradients[parameters] = overlap.imag();
+		psi_pending.assign(1, generator);
+		psi_pending.push_back(inverse_gate(g));
+		lambda_pending.assign(1, inverse_gate(g));
+	}
+	return code;
+}
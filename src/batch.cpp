@@ -0,0 +1,130 @@
+#include "batch.h"
+#include "ooc.h"
+
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <errno.h>
+
+// Столько амплитуд одного файла читается или пишется за раз
+#define BATCH_IO_CHUNK (1UL << 16)
+
+int batch_alloc(complexd **portion, const size_t number_of_qubits, const size_t states)
+{
+	const ulong portion_size = (1UL << number_of_qubits) / proc_num;
+	try
+	{
+		*portion = new complexd [portion_size * states];
+	}
+	catch (std::bad_alloc& ba)
+	{
+		fprintf(stderr, "%s\n", "Failed to allocate memory for a batch of vectors");
+		*portion = NULL;
+		return NO_MEMORY;
+	}
+	return SUCCESS;
+}
+
+void batch_free(complexd *portion)
+{
+	delete [] portion;
+}
+
+int batch_read_portion(complexd *portion, const size_t number_of_qubits, const size_t states, const size_t s, const char *filename)
+{
+	const ulong portion_size = (1UL << number_of_qubits) / proc_num;
+	const ulong chunk = std::min(portion_size, BATCH_IO_CHUNK);
+	const off_t offset = myrank * portion_size * sizeof(complexd);
+	std::vector<complexd> buffer(chunk);
+	int fd = open(filename, O_RDONLY);
+	if(fd < 0) {
+		fprintf(stderr, "Cannot open file %s\n", filename);
+		return errno;
+	}
+	int code = SUCCESS;
+	ulong start, i;
+	for(start = 0; start < portion_size && code == SUCCESS; start += chunk)
+	{
+		code = full_pread(fd, buffer.data(), chunk * sizeof(complexd), offset + start * sizeof(complexd));
+		for(i = 0; i < chunk && code == SUCCESS; i++)
+			portion[(start + i) * states + s] = buffer[i];
+	}
+	close(fd);
+	if(code != SUCCESS)
+		fprintf(stderr, "Error when reading file %s\n", filename);
+	return code;
+}
+
+int batch_read_vectors(complexd *portion, const size_t number_of_qubits, const std::vector<std::string> &files)
+{
+	int code = SUCCESS;
+	size_t s;
+	for(s = 0; s < files.size() && code == SUCCESS; s++)
+		code = batch_read_portion(portion, number_of_qubits, files.size(), s, files[s].c_str());
+	return collective_code(code);
+}
+
+int batch_write_vectors(const complexd *portion, const size_t number_of_qubits, const std::vector<std::string> &files)
+{
+	const size_t states = files.size();
+	const ulong portion_size = (1UL << number_of_qubits) / proc_num;
+	const ulong chunk = std::min(portion_size, BATCH_IO_CHUNK);
+	const off_t offset = myrank * portion_size * sizeof(complexd);
+	std::vector<complexd> buffer(chunk);
+	int code = SUCCESS;
+	size_t s;
+	// рутовый процесс создает файлы, затем каждый процесс пишет в них свою часть
+	if(i_am_the_master)
+		for(s = 0; s < states && code == SUCCESS; s++)
+		{
+			int fd = open(files[s].c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+			if(fd < 0) {
+				fprintf(stderr, "Error when opening file %s\n", files[s].c_str());
+				code = errno;
+			}
+			else
+				close(fd);
+		}
+	MPI_Bcast(&code, 1, MPI_INT, MASTER, MPI_COMM_WORLD);
+	for(s = 0; s < states && code == SUCCESS; s++)
+	{
+		int fd = open(files[s].c_str(), O_WRONLY);
+		if(fd < 0) {
+			code = errno;
+			break;
+		}
+		ulong start, i;
+		for(start = 0; start < portion_size && code == SUCCESS; start += chunk)
+		{
+			for(i = 0; i < chunk; i++)
+				buffer[i] = portion[(start + i) * states + s];
+			code = full_pwrite(fd, buffer.data(), chunk * sizeof(complexd), offset + start * sizeof(complexd));
+		}
+		close(fd);
+		if(code != SUCCESS)
+			fprintf(stderr, "Error when writing to file %s\n", files[s].c_str());
+	}
+	return collective_code(code);
+}
+
+int read_batch_list(const char *filename, std::vector<std::string> &inputs, std::vector<std::string> &outputs)
+{
+	FILE *f = fopen(filename, "r");
+	if(f == NULL) {
+		fprintf(stderr, "Cannot open file %s\n", filename);
+		return errno;
+	}
+	char input[4096], output[4096];
+	while(fscanf(f, "%4095s %4095s", input, output) == 2)
+	{
+		inputs.push_back(input);
+		outputs.push_back(output);
+	}
+	fclose(f);
+	if(inputs.empty()) {
+		fprintf(stderr, "No vectors listed in %s\n", filename);
+		return WRONG_VALUE;
+	}
+	return SUCCESS;
+}
@@ -0,0 +1,263 @@
+#include "checkpoint.h"
+#include "ooc.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+
+// Цепочки хешей последних запусков
+#define CHECKPOINT_HISTORY 8
+// Элементов части вектора на один хеш блока
+#define CHECKPOINT_HASH_BLOCK 4096
+
+static const ulong fnv_offset = 14695981039346656037UL, fnv_prime = 1099511628211UL;
+
+static inline ulong mix(ulong hash, const ulong word)
+{
+	return (hash ^ word) * fnv_prime;
+}
+
+static ulong hash_gate(ulong hash, const gate &g)
+{
+	hash = mix(hash, g.type);
+	size_t k;
+	for(k = 0; k < g.qubits_num; k++)
+		hash = mix(hash, g.qubits[k]);
+	ulong param;
+	memcpy(&param, &g.param, sizeof(param));
+	return mix(hash, param);
+}
+
+// Хеш всего вектора, одинаковый на всех процессах: хеши блоков части сворачиваются по порядку,
+// затем хеши частей всех процессов
+static ulong hash_state(const complexd *portion, const size_t number_of_qubits)
+{
+	const ulong portion_size = (1UL << number_of_qubits) / proc_num;
+	const long blocks = (portion_size + CHECKPOINT_HASH_BLOCK - 1) / CHECKPOINT_HASH_BLOCK;
+	std::vector<ulong> block_hashes(blocks);
+	long b;
+	#pragma omp parallel for
+	for(b = 0; b < blocks; b++)
+	{
+		const ulong *words = (const ulong *)(portion + b * CHECKPOINT_HASH_BLOCK);
+		const ulong end = 2 * (std::min(portion_size, ulong(b + 1) * CHECKPOINT_HASH_BLOCK) - b * CHECKPOINT_HASH_BLOCK);
+		ulong hash = fnv_offset, i;
+		for(i = 0; i < end; i++)
+			hash = mix(hash, words[i]);
+		block_hashes[b] = hash;
+	}
+	ulong hash = mix(fnv_offset, number_of_qubits);
+	for(b = 0; b < blocks; b++)
+		hash = mix(hash, block_hashes[b]);
+	std::vector<ulong> all(proc_num);
+	MPI_Allgather(&hash, 1, MPI_UNSIGNED_LONG, all.data(), 1, MPI_UNSIGNED_LONG, MPI_COMM_WORLD);
+	hash = fnv_offset;
+	int r;
+	for(r = 0; r < proc_num; r++)
+		hash = mix(hash, all[r]);
+	return hash;
+}
+
+void checkpoint_cache_init(checkpoint_cache *cache, const size_t memory_mb, const char *spill_prefix, const size_t spill_mb)
+{
+	cache->memory_limit = ulong(memory_mb) << 20;
+	cache->spill_limit = spill_prefix != NULL ? ulong(spill_mb) << 20 : 0;
+	cache->spill_prefix = spill_prefix != NULL ? spill_prefix : "";
+	cache->memory_used = cache->spill_used = 0;
+	cache->clock = 0;
+	cache->entries.clear();
+	cache->history.clear();
+	cache->runs = cache->hits = cache->gates_skipped = cache->gates_total = cache->spilled = 0;
+}
+
+static ulong entry_bytes(const checkpoint_entry &entry)
+{
+	return (1UL << entry.number_of_qubits) / proc_num * sizeof(complexd);
+}
+
+static void drop_entry(checkpoint_cache *cache, const size_t e)
+{
+	checkpoint_entry &entry = cache->entries[e];
+	if(entry.portion != NULL) {
+		delete [] entry.portion;
+		cache->memory_used -= entry_bytes(entry);
+	}
+	else {
+		unlink(entry.spill_file.c_str());
+		cache->spill_used -= entry_bytes(entry);
+	}
+	cache->entries.erase(cache->entries.begin() + e);
+}
+
+void checkpoint_cache_free(checkpoint_cache *cache)
+{
+	while(!cache->entries.empty())
+		drop_entry(cache, cache->entries.size() - 1);
+	cache->history.clear();
+}
+
+// Давно не использованная запись в памяти (on_disk = false) или на диске
+static long least_recent(const checkpoint_cache *cache, const bool on_disk)
+{
+	long found = -1;
+	size_t e;
+	for(e = 0; e < cache->entries.size(); e++)
+		if((cache->entries[e].portion == NULL) == on_disk && (found < 0 || cache->entries[e].last_use < cache->entries[found].last_use))
+			found = e;
+	return found;
+}
+
+// Перенос записи из памяти на диск; при ошибке записи запись отбрасывается (решение общее для всех процессов)
+static void spill_entry(checkpoint_cache *cache, const size_t e)
+{
+	checkpoint_entry &entry = cache->entries[e];
+	const ulong bytes = entry_bytes(entry);
+	char key[32];
+	snprintf(key, sizeof(key), "%016lx", entry.key);
+	entry.spill_file = cache->spill_prefix + "." + key + "." + std::to_string(myrank);
+	int code = SUCCESS;
+	int fd = open(entry.spill_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0)
+		code = errno;
+	else {
+		code = full_pwrite(fd, entry.portion, bytes, 0);
+		close(fd);
+	}
+	code = collective_code(code);
+	if(code != SUCCESS)
+	{
+		if(i_am_the_master)
+			fprintf(stderr, "Cannot spill a checkpoint to %s.*, it is dropped\n", cache->spill_prefix.c_str());
+		unlink(entry.spill_file.c_str());
+		drop_entry(cache, e);
+		return;
+	}
+	delete [] entry.portion;
+	entry.portion = NULL;
+	cache->memory_used -= bytes;
+	cache->spill_used += bytes;
+	cache->spilled++;
+}
+
+static void store(checkpoint_cache *cache, const ulong key, const size_t prefix, const complexd *portion, const size_t number_of_qubits)
+{
+	checkpoint_entry entry;
+	entry.key = key;
+	entry.prefix = prefix;
+	entry.number_of_qubits = number_of_qubits;
+	entry.last_use = cache->clock++;
+	const ulong bytes = entry_bytes(entry);
+	if(bytes > cache->memory_limit)
+		return;
+	// место в памяти освобождается вытеснением на диск, если там хватает места, иначе отбрасыванием
+	long victim;
+	while(cache->memory_used + bytes > cache->memory_limit && (victim = least_recent(cache, false)) >= 0)
+	{
+		const ulong victim_bytes = entry_bytes(cache->entries[victim]);
+		if(victim_bytes > cache->spill_limit) {
+			drop_entry(cache, victim);
+			continue;
+		}
+		long old;
+		while(cache->spill_used + victim_bytes > cache->spill_limit && (old = least_recent(cache, true)) >= 0)
+			drop_entry(cache, old);
+		// номер жертвы мог сдвинуться после удаления записей с диска
+		spill_entry(cache, least_recent(cache, false));
+	}
+	entry.portion = new (std::nothrow) complexd [bytes / sizeof(complexd)];
+	int failed = entry.portion == NULL;
+	MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+	if(failed) {
+		delete [] entry.portion;
+		return;
+	}
+	memcpy(entry.portion, portion, bytes);
+	cache->memory_used += bytes;
+	cache->entries.push_back(entry);
+}
+
+static int restore(checkpoint_cache *cache, checkpoint_entry &entry, complexd *portion)
+{
+	const ulong bytes = entry_bytes(entry);
+	entry.last_use = cache->clock++;
+	if(entry.portion != NULL) {
+		memcpy(portion, entry.portion, bytes);
+		return SUCCESS;
+	}
+	int code = SUCCESS;
+	int fd = open(entry.spill_file.c_str(), O_RDONLY);
+	if(fd < 0)
+		code = errno;
+	else {
+		code = full_pread(fd, portion, bytes, 0);
+		close(fd);
+	}
+	return collective_code(code);
+}
+
+int checkpoint_apply_circuit(checkpoint_cache *cache, complexd *portion, const size_t number_of_qubits, const gate *gates,
+	const size_t count, std::vector<int> *bits)
+{
+	// префиксы до первого измерения
+	size_t limit = 0, k;
+	while(limit < count && gates[limit].type != GATE_MEASURE)
+		limit++;
+	std::vector<ulong> chain(limit + 1);
+	chain[0] = hash_state(portion, number_of_qubits);
+	for(k = 0; k < limit; k++)
+		chain[k + 1] = hash_gate(chain[k], gates[k]);
+	// самый длинный сохраненный префикс
+	size_t start = 0, e, found = 0;
+	for(e = 0; e < cache->entries.size(); e++)
+	{
+		const checkpoint_entry &entry = cache->entries[e];
+		if(entry.number_of_qubits == number_of_qubits && entry.prefix <= limit && entry.prefix > start && chain[entry.prefix] == entry.key) {
+			start = entry.prefix;
+			found = e;
+		}
+	}
+	int code = SUCCESS;
+	if(start > 0)
+	{
+		code = restore(cache, cache->entries[found], portion);
+		if(code != SUCCESS) {
+			// состояние не прочиталось: запись отбрасывается, вектор уже испорчен
+			if(i_am_the_master)
+				fprintf(stderr, "Cannot read checkpoint %s\n", cache->entries[found].spill_file.c_str());
+			drop_entry(cache, found);
+			return code;
+		}
+		cache->hits++;
+	}
+	// общая часть с прошлыми запусками: цепочки совпадают до первого расхождения
+	size_t common = 0, h;
+	for(h = 0; h < cache->history.size(); h++)
+	{
+		const std::vector<ulong> &previous = cache->history[h];
+		size_t length = 0;
+		while(length + 1 < std::min(previous.size(), chain.size()) && previous[length + 1] == chain[length + 1])
+			length++;
+		if(previous[0] == chain[0])
+			common = std::max(common, length);
+	}
+	cache->runs++;
+	cache->gates_total += count;
+	cache->gates_skipped += start;
+	if(common > start)
+	{
+		code = apply_circuit_dense(portion, number_of_qubits, gates + start, common - start);
+		if(code == SUCCESS)
+			store(cache, chain[common], common, portion, number_of_qubits);
+		start = common;
+	}
+	if(code == SUCCESS)
+		code = apply_circuit_dense(portion, number_of_qubits, gates + start, count - start, bits);
+	cache->history.push_back(chain);
+	if(cache->history.size() > CHECKPOINT_HISTORY)
+		cache->history.erase(cache->history.begin());
+	return code;
+}
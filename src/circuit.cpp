@@ -0,0 +1,406 @@
+#include "circuit.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+static const double pi = std::acos(-1);
+
+struct gate_description
+{
+	const char *name;
+	int type;
+	size_t qubits_num;
+	size_t params_num;
+};
+
+static const gate_description gate_table[] = {
+	{ "h", GATE_H, 1, 0 },
+	{ "x", GATE_X, 1, 0 },
+	{ "z", GATE_Z, 1, 0 },
+	{ "rz", GATE_RZ, 1, 1 },
+	{ "rx", GATE_RX, 1, 1 },
+	{ "cx", GATE_CX, 2, 0 },
+	{ "CX", GATE_CX, 2, 0 },
+	{ "cp", GATE_CP, 2, 1 },
+	{ "cu1", GATE_CP, 2, 1 },
+	{ "ccx", GATE_CCX, 3, 0 },
+	{ "swap", GATE_SWAP, 2, 0 },
+	{ NULL, 0, 0, 0 }
+};
+
+const char *gate_name(const int type)
+{
+	if(type == GATE_MEASURE)
+		return "measure";
+	const gate_description *d;
+	for(d = gate_table; d->name != NULL; d++)
+		if(d->type == type)
+			return d->name;
+	return "?";
+}
+
+static int parse_error(const circuit_parser *parser, const std::string &msg)
+{
+	fprintf(stderr, "Circuit line %zu: %s\n", parser->line, msg.c_str());
+	return WRONG_VALUE;
+}
+
+// Читает оператор до ';', пропуская комментарии. false - конец файла
+static bool read_statement(circuit_parser *parser, std::string &statement)
+{
+	statement.clear();
+	int c, prev = 0;
+	while((c = fgetc(parser->input)) != EOF)
+	{
+		if(c == '\n')
+			parser->line++;
+		if(c == '/' && prev == '/')
+		{
+			statement.erase(statement.size() - 1);
+			while((c = fgetc(parser->input)) != EOF && c != '\n')
+				;
+			parser->line++;
+			prev = 0;
+			continue;
+		}
+		if(c == ';')
+			return true;
+		statement += char(c);
+		prev = c;
+	}
+	// после последнего ';' могут остаться только пробелы
+	size_t k;
+	for(k = 0; k < statement.size(); k++)
+		if(!isspace((unsigned char)statement[k]))
+			return true;
+	return false;
+}
+
+static void skip_spaces(const std::string &s, size_t &pos)
+{
+	while(pos < s.size() && isspace((unsigned char)s[pos]))
+		pos++;
+}
+
+static std::string read_identifier(const std::string &s, size_t &pos)
+{
+	skip_spaces(s, pos);
+	size_t start = pos;
+	while(pos < s.size() && (isalnum((unsigned char)s[pos]) || s[pos] == '_'))
+		pos++;
+	return s.substr(start, pos - start);
+}
+
+// Параметры вентилей: числа, pi, + - * / и скобки
+static bool parse_expression(const std::string &s, size_t &pos, double &value);
+
+static bool parse_factor(const std::string &s, size_t &pos, double &value)
+{
+	skip_spaces(s, pos);
+	if(pos >= s.size())
+		return false;
+	if(s[pos] == '-' || s[pos] == '+')
+	{
+		bool negative = s[pos++] == '-';
+		if(!parse_factor(s, pos, value))
+			return false;
+		if(negative)
+			value = -value;
+		return true;
+	}
+	if(s[pos] == '(')
+	{
+		pos++;
+		if(!parse_expression(s, pos, value))
+			return false;
+		skip_spaces(s, pos);
+		if(pos >= s.size() || s[pos] != ')')
+			return false;
+		pos++;
+		return true;
+	}
+	if(s.compare(pos, 2, "pi") == 0)
+	{
+		pos += 2;
+		value = pi;
+		return true;
+	}
+	const char *start = s.c_str() + pos;
+	char *end = NULL;
+	value = strtod(start, &end);
+	if(end == start)
+		return false;
+	pos += end - start;
+	return true;
+}
+
+static bool parse_term(const std::string &s, size_t &pos, double &value)
+{
+	if(!parse_factor(s, pos, value))
+		return false;
+	for(;;)
+	{
+		skip_spaces(s, pos);
+		if(pos >= s.size() || (s[pos] != '*' && s[pos] != '/'))
+			return true;
+		char op = s[pos++];
+		double rhs;
+		if(!parse_factor(s, pos, rhs))
+			return false;
+		value = op == '*' ? value * rhs : value / rhs;
+	}
+}
+
+static bool parse_expression(const std::string &s, size_t &pos, double &value)
+{
+	if(!parse_term(s, pos, value))
+		return false;
+	for(;;)
+	{
+		skip_spaces(s, pos);
+		if(pos >= s.size() || (s[pos] != '+' && s[pos] != '-'))
+			return true;
+		char op = s[pos++];
+		double rhs;
+		if(!parse_term(s, pos, rhs))
+			return false;
+		value = op == '+' ? value + rhs : value - rhs;
+	}
+}
+
+// Аргумент name или name[index]: список номеров (с единицы) всех кубитов или битов, к которым он относится
+static int parse_argument(circuit_parser *parser, const std::string &arg, const std::map<std::string, qasm_register> &registers, std::vector<size_t> &items)
+{
+	size_t pos = 0;
+	std::string name = read_identifier(arg, pos);
+	std::map<std::string, qasm_register>::const_iterator it = registers.find(name);
+	if(it == registers.end())
+		return parse_error(parser, "unknown register '" + name + "'");
+	items.clear();
+	skip_spaces(arg, pos);
+	if(pos == arg.size())
+	{
+		size_t k;
+		for(k = 0; k < it->second.size; k++)
+			items.push_back(it->second.offset + k + 1);
+		return SUCCESS;
+	}
+	if(arg[pos] != '[')
+		return parse_error(parser, "bad argument '" + arg + "'");
+	char *end = NULL;
+	long index = strtol(arg.c_str() + pos + 1, &end, 10);
+	if(end == arg.c_str() + pos + 1 || *end != ']' || index < 0 || (size_t)index >= it->second.size)
+		return parse_error(parser, "bad index in '" + arg + "'");
+	items.push_back(it->second.offset + index + 1);
+	return SUCCESS;
+}
+
+static void split(const std::string &s, const char delimiter, std::vector<std::string> &parts)
+{
+	parts.clear();
+	size_t start = 0, pos;
+	while((pos = s.find(delimiter, start)) != std::string::npos)
+	{
+		parts.push_back(s.substr(start, pos - start));
+		start = pos + 1;
+	}
+	parts.push_back(s.substr(start));
+}
+
+static int declare_register(circuit_parser *parser, const std::string &rest, std::map<std::string, qasm_register> &registers, size_t &declared)
+{
+	size_t pos = 0;
+	std::string name = read_identifier(rest, pos);
+	skip_spaces(rest, pos);
+	char *end = NULL;
+	long size = pos < rest.size() && rest[pos] == '[' ? strtol(rest.c_str() + pos + 1, &end, 10) : 0;
+	if(name.empty() || size <= 0 || *end != ']')
+		return parse_error(parser, "bad register declaration");
+	if(registers.count(name))
+		return parse_error(parser, "register '" + name + "' is declared twice");
+	qasm_register reg;
+	reg.offset = declared;
+	reg.size = size;
+	registers[name] = reg;
+	declared += size;
+	return SUCCESS;
+}
+
+// Разбирает один оператор, вентили добавляются в parser->pending
+static int parse_statement(circuit_parser *parser, const std::string &statement)
+{
+	size_t pos = 0;
+	std::string name = read_identifier(statement, pos);
+	std::string rest = statement.substr(pos);
+	if(name.empty())
+		return parse_error(parser, "cannot parse '" + statement + "'");
+	if(name == "OPENQASM" || name == "include" || name == "barrier")
+		return SUCCESS;
+	if(name == "qreg")
+	{
+		int code = declare_register(parser, rest, parser->qregs, parser->qubits_declared);
+		if(code == SUCCESS && parser->qubits_declared > parser->number_of_qubits)
+			return parse_error(parser, "registers have more qubits than the state vector");
+		return code;
+	}
+	if(name == "creg")
+		return declare_register(parser, rest, parser->cregs, parser->bits_declared);
+	std::vector<size_t> qubits, bits;
+	int code;
+	if(name == "measure")
+	{
+		size_t arrow = rest.find("->");
+		if(arrow == std::string::npos)
+			return parse_error(parser, "measure needs '->'");
+		if((code = parse_argument(parser, rest.substr(0, arrow), parser->qregs, qubits)) != SUCCESS ||
+		   (code = parse_argument(parser, rest.substr(arrow + 2), parser->cregs, bits)) != SUCCESS)
+			return code;
+		if(qubits.size() != bits.size())
+			return parse_error(parser, "measure registers differ in size");
+		size_t k;
+		// номер классического бита хранится в параметре
+		for(k = 0; k < qubits.size(); k++)
+			parser->pending.push_back(make_gate1(GATE_MEASURE, qubits[k], bits[k] - 1));
+		return SUCCESS;
+	}
+	if(name == "qft")
+	{
+		if((code = parse_argument(parser, rest, parser->qregs, qubits)) != SUCCESS)
+			return code;
+		std::vector<gate> expanded;
+		qft_circuit(qubits.size(), expanded);
+		size_t k, j;
+		for(k = 0; k < expanded.size(); k++)
+		{
+			for(j = 0; j < expanded[k].qubits_num; j++)
+				expanded[k].qubits[j] = qubits[expanded[k].qubits[j] - 1];
+			parser->pending.push_back(expanded[k]);
+		}
+		return SUCCESS;
+	}
+	const gate_description *desc;
+	for(desc = gate_table; desc->name != NULL; desc++)
+		if(name == desc->name)
+			break;
+	if(desc->name == NULL)
+		return parse_error(parser, "unsupported operation '" + name + "'");
+	double param = 0;
+	pos = 0;
+	skip_spaces(rest, pos);
+	if(desc->params_num > 0)
+	{
+		if(pos >= rest.size() || rest[pos] != '(')
+			return parse_error(parser, name + " needs a parameter");
+		pos++;
+		if(!parse_expression(rest, pos, param))
+			return parse_error(parser, "bad parameter of " + name);
+		skip_spaces(rest, pos);
+		if(pos >= rest.size() || rest[pos] != ')')
+			return parse_error(parser, "')' expected");
+		pos++;
+	}
+	std::vector<std::string> args;
+	split(rest.substr(pos), ',', args);
+	if(args.size() != desc->qubits_num)
+		return parse_error(parser, name + " needs " + std::to_string(desc->qubits_num) + " arguments");
+	// целый регистр в аргументе - вентиль применяется к каждому его кубиту
+	std::vector< std::vector<size_t> > operands(args.size());
+	size_t k, j, repeat = 1;
+	for(k = 0; k < args.size(); k++)
+	{
+		if((code = parse_argument(parser, args[k], parser->qregs, operands[k])) != SUCCESS)
+			return code;
+		if(operands[k].size() > 1)
+		{
+			if(repeat > 1 && operands[k].size() != repeat)
+				return parse_error(parser, "registers differ in size");
+			repeat = operands[k].size();
+		}
+	}
+	for(j = 0; j < repeat; j++)
+	{
+		gate g = make_gate1(desc->type, 1, param);
+		g.qubits_num = desc->qubits_num;
+		for(k = 0; k < desc->qubits_num; k++)
+			g.qubits[k] = operands[k].size() > 1 ? operands[k][j] : operands[k][0];
+		if((g.qubits_num > 1 && g.qubits[0] == g.qubits[1]) ||
+		   (g.qubits_num > 2 && (g.qubits[0] == g.qubits[2] || g.qubits[1] == g.qubits[2])))
+			return parse_error(parser, "repeated qubit in " + name);
+		parser->pending.push_back(g);
+	}
+	return SUCCESS;
+}
+
+int circuit_open(circuit_parser *parser, const char *filename, const size_t number_of_qubits)
+{
+	parser->input = NULL;
+	parser->number_of_qubits = number_of_qubits;
+	parser->qubits_declared = 0;
+	parser->bits_declared = 0;
+	parser->line = 1;
+	parser->qregs.clear();
+	parser->cregs.clear();
+	parser->pending.clear();
+	int code = SUCCESS;
+	if(i_am_the_master)
+	{
+		parser->input = fopen(filename, "r");
+		if(parser->input == NULL)
+		{
+			fprintf(stderr, "Cannot open file %s\n", filename);
+			code = NOT_SUCCESS;
+		}
+	}
+	MPI_Bcast(&code, 1, MPI_INT, MASTER, MPI_COMM_WORLD);
+	return code;
+}
+
+int circuit_next_batch(circuit_parser *parser, std::vector<gate> &batch, const size_t max_gates)
+{
+	int count = 0;
+	batch.clear();
+	if(i_am_the_master)
+	{
+		std::string statement;
+		int code = SUCCESS;
+		while(parser->pending.size() < max_gates && code == SUCCESS && read_statement(parser, statement))
+			code = parse_statement(parser, statement);
+		size_t taken = std::min(max_gates, parser->pending.size());
+		batch.assign(parser->pending.begin(), parser->pending.begin() + taken);
+		parser->pending.erase(parser->pending.begin(), parser->pending.begin() + taken);
+		count = code == SUCCESS ? int(taken) : -1;
+	}
+	MPI_Bcast(&count, 1, MPI_INT, MASTER, MPI_COMM_WORLD);
+	if(count < 0)
+		return WRONG_VALUE;
+	batch.resize(count);
+	MPI_Bcast(batch.data(), count * sizeof(gate), MPI_BYTE, MASTER, MPI_COMM_WORLD);
+	return SUCCESS;
+}
+
+void circuit_close(circuit_parser *parser)
+{
+	if(parser->input != NULL)
+		fclose(parser->input);
+	parser->input = NULL;
+}
+
+int read_circuit(const char *filename, const size_t number_of_qubits, std::vector<gate> &gates)
+{
+	circuit_parser parser;
+	int code = circuit_open(&parser, filename, number_of_qubits);
+	std::vector<gate> batch;
+	gates.clear();
+	while(code == SUCCESS)
+	{
+		code = circuit_next_batch(&parser, batch);
+		if(code != SUCCESS || batch.empty())
+			break;
+		gates.insert(gates.end(), batch.begin(), batch.end());
+	}
+	circuit_close(&parser);
+	return code;
+}
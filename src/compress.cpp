@@ -0,0 +1,220 @@
+#include "compress.h"
+
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+#include <stdio.h>
+
+// Способ хранения блока, записывается первым байтом
+#define BLOCK_ZERO 0		// все амплитуды нулевые, больше ничего не хранится
+#define BLOCK_RAW 1			// сжатие не помогло, хранится как есть
+#define BLOCK_SHUFFLED 2	// байты double переставлены по плоскостям и сжаты LZ
+#define BLOCK_QUANTIZED 3	// компоненты квантованы, целые переставлены по плоскостям и сжаты LZ
+
+static void put_varint(std::vector<unsigned char> &out, ulong v)
+{
+	while(v >= 128)
+	{
+		out.push_back((v & 127) | 128);
+		v >>= 7;
+	}
+	out.push_back(v);
+}
+
+static const unsigned char *get_varint(const unsigned char *p, ulong &v)
+{
+	int shift = 0;
+	v = 0;
+	while(*p & 128)
+	{
+		v |= ulong(*p++ & 127) << shift;
+		shift += 7;
+	}
+	v |= ulong(*p++) << shift;
+	return p;
+}
+
+// Простой LZ77: последовательность (число литералов, литералы, длина совпадения, смещение).
+// Совпадения ищутся по хешу четырех байтов; длинные серии одинаковых байтов кодируются смещением 1.
+static void lz_compress(const unsigned char *in, const size_t n, std::vector<unsigned char> &out)
+{
+	const int hash_bits = 14;
+	std::vector<long> table(1 << hash_bits, -1);
+	size_t anchor = 0, i = 0;
+	while(i + 4 <= n)
+	{
+		uint32_t seq;
+		memcpy(&seq, in + i, 4);
+		size_t h = (seq * 2654435761u) >> (32 - hash_bits);
+		long candidate = table[h];
+		table[h] = i;
+		if(candidate < 0 || memcmp(in + candidate, in + i, 4) != 0)
+		{
+			i++;
+			continue;
+		}
+		size_t len = 4;
+		while(i + len < n && in[candidate + len] == in[i + len])
+			len++;
+		put_varint(out, i - anchor);
+		out.insert(out.end(), in + anchor, in + i);
+		put_varint(out, len);
+		put_varint(out, i - candidate);
+		i += len;
+		anchor = i;
+	}
+	put_varint(out, n - anchor);
+	out.insert(out.end(), in + anchor, in + n);
+	put_varint(out, 0);
+}
+
+static void lz_decompress(const unsigned char *in, unsigned char *out, const size_t n)
+{
+	size_t pos = 0;
+	while(pos < n)
+	{
+		ulong literals, len, offset;
+		in = get_varint(in, literals);
+		memcpy(out + pos, in, literals);
+		in += literals;
+		pos += literals;
+		in = get_varint(in, len);
+		if(len == 0)
+			continue;
+		in = get_varint(in, offset);
+		// совпадение может перекрываться с собой, поэтому копируем по байту
+		size_t k;
+		for(k = 0; k < len; k++, pos++)
+			out[pos] = out[pos - offset];
+	}
+}
+
+// Плоскость b содержит b-й байт каждого восьмибайтного слова: у близких чисел старшие байты совпадают
+static void shuffle(const unsigned char *in, unsigned char *out, const size_t words)
+{
+	size_t w, b;
+	for(w = 0; w < words; w++)
+		for(b = 0; b < 8; b++)
+			out[b*words + w] = in[8*w + b];
+}
+
+static void unshuffle(const unsigned char *in, unsigned char *out, const size_t words)
+{
+	size_t w, b;
+	for(w = 0; w < words; w++)
+		for(b = 0; b < 8; b++)
+			out[8*w + b] = in[b*words + w];
+}
+
+int compressed_storage::init(const ulong portion_size, const ulong _block_size, const double _error_bound)
+{
+	if(_error_bound < 0 || (_error_bound > 0 && _error_bound < COMPRESS_MIN_ERROR_BOUND) || _block_size == 0 || portion_size % _block_size != 0)
+	{
+		fprintf(stderr, "%s\n", "Wrong compression parameters");
+		return WRONG_VALUE;
+	}
+	block_size = _block_size;
+	error_bound = _error_bound;
+	// изначально все блоки нулевые
+	blocks.assign(portion_size / block_size, std::vector<unsigned char>(1, BLOCK_ZERO));
+	return SUCCESS;
+}
+
+int compressed_storage::store(const ulong block_num, const complexd *buffer)
+{
+	const size_t words = 2 * block_size;
+	const double *values = (const double *)buffer;
+	std::vector<unsigned char> &out = blocks[block_num];
+	out.clear();
+	size_t w;
+	for(w = 0; w < words && values[w] == 0.0; w++)
+		;
+	if(w == words)
+	{
+		out.push_back(BLOCK_ZERO);
+		out.shrink_to_fit();
+		return SUCCESS;
+	}
+	std::vector<unsigned char> planes(8 * words);
+	// номер узла решетки со сдвинутым знаком должен поместиться в 64 бита, иначе блок сжимается без потерь
+	bool quantize = error_bound > 0;
+	for(w = 0; w < words && quantize; w++)
+		quantize = fabs(values[w]) / (2 * error_bound) < 4611686018427387904.0;
+	if(quantize)
+	{
+		// квант 2*error_bound: после округления ошибка не больше error_bound.
+		// Знак переносим в младший бит, чтобы у малых по модулю чисел старшие байты были нулевыми
+		std::vector<uint64_t> quantized(words);
+		for(w = 0; w < words; w++)
+		{
+			int64_t q = llround(values[w] / (2 * error_bound));
+			quantized[w] = (uint64_t(q) << 1) ^ uint64_t(q >> 63);
+		}
+		shuffle((const unsigned char *)quantized.data(), planes.data(), words);
+		out.push_back(BLOCK_QUANTIZED);
+	}
+	else
+	{
+		shuffle((const unsigned char *)values, planes.data(), words);
+		out.push_back(BLOCK_SHUFFLED);
+	}
+	lz_compress(planes.data(), planes.size(), out);
+	if(out.size() > 8 * words && !quantize)
+	{
+		out.assign(1, BLOCK_RAW);
+		out.insert(out.end(), (const unsigned char *)values, (const unsigned char *)(values + words));
+	}
+	out.shrink_to_fit();
+	return SUCCESS;
+}
+
+int compressed_storage::load(const ulong block_num, complexd *buffer)
+{
+	const size_t words = 2 * block_size;
+	const std::vector<unsigned char> &in = blocks[block_num];
+	double *values = (double *)buffer;
+	size_t w;
+	switch(in[0])
+	{
+		case BLOCK_ZERO:
+			for(w = 0; w < words; w++)
+				values[w] = 0.0;
+			break;
+		case BLOCK_RAW:
+			memcpy(values, in.data() + 1, 8 * words);
+			break;
+		case BLOCK_SHUFFLED:
+		{
+			std::vector<unsigned char> planes(8 * words);
+			lz_decompress(in.data() + 1, planes.data(), planes.size());
+			unshuffle(planes.data(), (unsigned char *)values, words);
+			break;
+		}
+		case BLOCK_QUANTIZED:
+		{
+			std::vector<unsigned char> planes(8 * words);
+			std::vector<uint64_t> quantized(words);
+			lz_decompress(in.data() + 1, planes.data(), planes.size());
+			unshuffle(planes.data(), (unsigned char *)quantized.data(), words);
+			for(w = 0; w < words; w++)
+			{
+				int64_t q = int64_t(quantized[w] >> 1) ^ -int64_t(quantized[w] & 1);
+				values[w] = q * (2 * error_bound);
+			}
+			break;
+		}
+		default:
+			fprintf(stderr, "%s\n", "Corrupted compressed block");
+			return NOT_SUCCESS;
+	}
+	return SUCCESS;
+}
+
+ulong compressed_storage::compressed_bytes() const
+{
+	ulong sum = 0;
+	size_t k;
+	for(k = 0; k < blocks.size(); k++)
+		sum += blocks[k].size();
+	return sum;
+}
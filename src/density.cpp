@@ -0,0 +1,242 @@
+#include "density.h"
+#include "ooc.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+
+int read_full_vector(complexd *psi, const size_t number_of_qubits, const char *filename)
+{
+	int code = SUCCESS;
+	int fd = open(filename, O_RDONLY);
+	if(fd < 0) {
+		fprintf(stderr, "Cannot open file %s\n", filename);
+		code = errno;
+	}
+	else {
+		code = full_pread(fd, psi, (1UL << number_of_qubits) * sizeof(complexd), 0);
+		close(fd);
+		if(code != SUCCESS)
+			fprintf(stderr, "Error when reading file %s\n", filename);
+	}
+	return collective_code(code);
+}
+
+void density_from_pure(complexd *rho, const size_t number_of_qubits, const complexd *psi)
+{
+	const ulong portion_size = (1UL << (2 * number_of_qubits)) / proc_num;
+	const ulong first = myrank * portion_size, column_mask = (1UL << number_of_qubits) - 1;
+	long i;
+	const long size = portion_size;
+	#pragma omp parallel for
+	for(i = 0; i < size; i++)
+	{
+		const ulong index = first + i;
+		rho[i] = psi[index >> number_of_qubits] * std::conj(psi[index & column_mask]);
+	}
+}
+
+// Вентиль U* на кубитах столбца
+static gate conjugate_gate(const gate &g, const size_t number_of_qubits)
+{
+	gate result = g;
+	size_t k;
+	for(k = 0; k < g.qubits_num; k++)
+		result.qubits[k] += number_of_qubits;
+	// H, X, Z, CX, CCX и SWAP вещественные
+	if(g.type == GATE_RZ || g.type == GATE_RX || g.type == GATE_CP)
+		result.param = -g.param;
+	return result;
+}
+
+// Супероператор канала с операторами Крауса: s[2r'+c'][2r+c] += weight * K[r'][r] * conj(K[c'][c])
+static void add_kraus(complexd *s, const complexd *k, const double weight)
+{
+	int row, column;
+	for(row = 0; row < 4; row++)
+		for(column = 0; column < 4; column++)
+			s[4 * row + column] += weight * k[2 * (row >> 1) + (column >> 1)] * std::conj(k[2 * (row & 1) + (column & 1)]);
+}
+
+// s = a * s
+static void multiply4(const complexd *a, complexd *s)
+{
+	complexd result[16];
+	int row, column, k;
+	for(row = 0; row < 4; row++)
+		for(column = 0; column < 4; column++)
+		{
+			result[4 * row + column] = 0;
+			for(k = 0; k < 4; k++)
+				result[4 * row + column] += a[4 * row + k] * s[4 * k + column];
+		}
+	std::copy(result, result + 16, s);
+}
+
+// Шум run_trajectories одной матрицей 4x4: поворот, затем деполяризация, затем затухание амплитуды
+static void noise_superoperator(const noise_model *model, complexd *s)
+{
+	const complexd identity[4] = { 1, 0, 0, 1 };
+	std::fill(s, s + 16, complexd(0));
+	add_kraus(s, identity, 1);
+	complexd channel[16];
+	if(model->rotation > 0)
+	{
+		// угол normal() * rotation приближается нормальным распределением с той же дисперсией (normal() - сумма 20 равномерных),
+		// тогда E[cos^2 t] = (1 + e^{-2v}) / 2, а E[sin t cos t] = 0
+		const double variance = model->rotation * model->rotation * 20 / 12;
+		const double cos2 = (1 + exp(-2 * variance)) / 2;
+		const complexd rotation[4] = { 0, 1, -1, 0 };
+		std::fill(channel, channel + 16, complexd(0));
+		add_kraus(channel, identity, cos2);
+		add_kraus(channel, rotation, 1 - cos2);
+		multiply4(channel, s);
+	}
+	if(model->depolarizing > 0)
+	{
+		const complexd i_unit(0, 1);
+		const complexd paulis[3][4] = { { 0, 1, 1, 0 }, { 0, -i_unit, i_unit, 0 }, { 1, 0, 0, -1 } };
+		std::fill(channel, channel + 16, complexd(0));
+		add_kraus(channel, identity, 1 - model->depolarizing);
+		int p;
+		for(p = 0; p < 3; p++)
+			add_kraus(channel, paulis[p], model->depolarizing / 3);
+		multiply4(channel, s);
+	}
+	if(model->damping > 0)
+	{
+		const complexd keep[4] = { 1, 0, 0, sqrt(1 - model->damping) }, jump[4] = { 0, sqrt(model->damping), 0, 0 };
+		std::fill(channel, channel + 16, complexd(0));
+		add_kraus(channel, keep, 1);
+		add_kraus(channel, jump, 1);
+		multiply4(channel, s);
+	}
+}
+
+// i с нулями, вставленными на места битов low < high
+static inline ulong insert_two_zeros(const ulong i, const ulong low, const ulong high)
+{
+	const ulong index = ((i & ~(low - 1)) << 1) | (i & (low - 1));
+	return ((index & ~(high - 1)) << 1) | (index & (high - 1));
+}
+
+// Один проход: четверки с битами row и column, слитый супероператор s
+static void apply_superoperator(complexd *rho, const ulong portion_size, const ulong row, const ulong column, const complexd *s)
+{
+	const ulong low = std::min(row, column), high = std::max(row, column);
+	long i;
+	const long quads = portion_size / 4;
+	#pragma omp parallel for
+	for(i = 0; i < quads; i++)
+	{
+		const ulong base = insert_two_zeros(i, low, high);
+		complexd *a[4] = { rho + base, rho + (base | column), rho + (base | row), rho + (base | row | column) };
+		const complexd x[4] = { *a[0], *a[1], *a[2], *a[3] };
+		int k;
+		for(k = 0; k < 4; k++)
+			*a[k] = s[4 * k] * x[0] + s[4 * k + 1] * x[1] + s[4 * k + 2] * x[2] + s[4 * k + 3] * x[3];
+	}
+}
+
+static int noise_on_qubit(complexd *rho, const size_t number_of_qubits, const size_t qubit, const complexd *s)
+{
+	const size_t qubits = 2 * number_of_qubits;
+	const ulong portion_size = (1UL << qubits) / proc_num;
+	ulong row = 1UL << (qubits - qubit);
+	const ulong column = 1UL << (number_of_qubits - qubit);
+	// глобальный бит строки временно меняется местами с последним кубитом (или предпоследним, если последний - кубит столбца)
+	const size_t partner = qubit == number_of_qubits ? qubits - 1 : qubits;
+	const bool global = row >= portion_size;
+	const gate swap = make_gate2(GATE_SWAP, qubit, partner);
+	int code = SUCCESS;
+	if(global) {
+		code = apply_circuit_dense(rho, qubits, &swap, 1);
+		row = 1UL << (qubits - partner);
+	}
+	if(code == SUCCESS)
+		apply_superoperator(rho, portion_size, row, column, s);
+	if(code == SUCCESS && global)
+		code = apply_circuit_dense(rho, qubits, &swap, 1);
+	return code;
+}
+
+int density_apply(complexd *rho, const size_t number_of_qubits, const gate *gates, const size_t count, const noise_model *model)
+{
+	const size_t qubits = 2 * number_of_qubits;
+	std::vector<gate> doubled;
+	size_t g, k;
+	for(g = 0; g < count; g++)
+	{
+		if(gates[g].type == GATE_MEASURE) {
+			if(i_am_the_master)
+				fprintf(stderr, "%s\n", "Measurement is not supported in density matrix simulation");
+			return WRONG_VALUE;
+		}
+		doubled.push_back(gates[g]);
+		doubled.push_back(conjugate_gate(gates[g], number_of_qubits));
+	}
+	const bool noisy = model->rotation > 0 || model->depolarizing > 0 || model->damping > 0;
+	if(!noisy)
+		// вся удвоенная схема за один вызов: исполнитель сам объединяет вентили
+		return apply_circuit_dense(rho, qubits, doubled.data(), doubled.size());
+	complexd s[16];
+	noise_superoperator(model, s);
+	int code = SUCCESS;
+	for(g = 0; g < count && code == SUCCESS; g++)
+	{
+		code = apply_circuit_dense(rho, qubits, &doubled[2 * g], 2);
+		for(k = 0; k < gates[g].qubits_num && code == SUCCESS; k++)
+			code = noise_on_qubit(rho, number_of_qubits, gates[g].qubits[k], s);
+	}
+	return code;
+}
+
+double density_trace(const complexd *rho, const size_t number_of_qubits)
+{
+	// по диагональным элементам части: индекс r * (2^n + 1)
+	const ulong dimension = 1UL << number_of_qubits;
+	const ulong portion_size = (1UL << (2 * number_of_qubits)) / proc_num;
+	const ulong first = myrank * portion_size, last = first + portion_size;
+	const long first_row = (first + dimension) / (dimension + 1), last_row = std::min(dimension, (last + dimension) / (dimension + 1));
+	double trace = 0;
+	long r;
+	#pragma omp parallel for reduction(+:trace)
+	for(r = first_row; r < last_row; r++)
+		trace += rho[r * (dimension + 1) - first].real();
+	MPI_Allreduce(MPI_IN_PLACE, &trace, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+	return trace;
+}
+
+double density_purity(const complexd *rho, const size_t number_of_qubits)
+{
+	// rho эрмитова, поэтому Tr(rho^2) = sum |rho_rc|^2
+	const long size = (1UL << (2 * number_of_qubits)) / proc_num;
+	double purity = 0;
+	long i;
+	#pragma omp parallel for reduction(+:purity)
+	for(i = 0; i < size; i++)
+		purity += std::norm(rho[i]);
+	MPI_Allreduce(MPI_IN_PLACE, &purity, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+	return purity;
+}
+
+double density_fidelity(const complexd *rho, const size_t number_of_qubits, const complexd *psi)
+{
+	const ulong portion_size = (1UL << (2 * number_of_qubits)) / proc_num;
+	const ulong first = myrank * portion_size, column_mask = (1UL << number_of_qubits) - 1;
+	// мнимая часть суммы по всей матрице равна нулю
+	double re = 0;
+	long i;
+	const long size = portion_size;
+	#pragma omp parallel for reduction(+:re)
+	for(i = 0; i < size; i++)
+	{
+		const ulong index = first + i;
+		re += (std::conj(psi[index >> number_of_qubits]) * rho[i] * psi[index & column_mask]).real();
+	}
+	MPI_Allreduce(MPI_IN_PLACE, &re, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+	return re;
+}
@@ -0,0 +1,170 @@
+#include "estimate.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <omp.h>
+#include <stdio.h>
+
+#define CALIBRATION_REPEATS 3
+#define LATENCY_REPEATS 100
+
+void default_costs(kernel_costs *costs)
+{
+	costs->thread_bandwidth = 2e9;
+	costs->memory_bandwidth = 10e9;
+	costs->network_bandwidth = 1e9;
+	costs->network_latency = 5e-6;
+}
+
+struct cost_field
+{
+	const char *name;
+	size_t offset;
+};
+
+static const cost_field cost_fields[] = {
+	{ "thread_bandwidth", offsetof(kernel_costs, thread_bandwidth) },
+	{ "memory_bandwidth", offsetof(kernel_costs, memory_bandwidth) },
+	{ "network_bandwidth", offsetof(kernel_costs, network_bandwidth) },
+	{ "network_latency", offsetof(kernel_costs, network_latency) },
+	{ NULL, 0 }
+};
+
+int read_costs(kernel_costs *costs, const char *filename)
+{
+	FILE *f = fopen(filename, "r");
+	if(f == NULL) {
+		fprintf(stderr, "Cannot open file %s\n", filename);
+		return errno;
+	}
+	default_costs(costs);
+	char name[64];
+	double value;
+	int code = SUCCESS;
+	while(code == SUCCESS && fscanf(f, "%63s %lf", name, &value) == 2)
+	{
+		const cost_field *field;
+		for(field = cost_fields; field->name != NULL && strcmp(field->name, name) != 0; field++)
+			;
+		if(field->name == NULL || value <= 0) {
+			fprintf(stderr, "Wrong cost %s in %s\n", name, filename);
+			code = WRONG_VALUE;
+		}
+		else
+			*(double *)((char *)costs + field->offset) = value;
+	}
+	fclose(f);
+	return code;
+}
+
+int write_costs(const kernel_costs *costs, const char *filename)
+{
+	FILE *f = fopen(filename, "w");
+	if(f == NULL) {
+		fprintf(stderr, "Error when opening file %s\n", filename);
+		return errno;
+	}
+	const cost_field *field;
+	for(field = cost_fields; field->name != NULL; field++)
+		fprintf(f, "%s %.6e\n", field->name, *(const double *)((const char *)costs + field->offset));
+	fclose(f);
+	return SUCCESS;
+}
+
+// Лучшее из нескольких повторений времени прохода адамара по младшему биту
+static double time_sweep(complexd *portion, const ulong portion_size)
+{
+	const gate h = make_gate1(GATE_H, 1);
+	const ulong mask = 1;
+	double best = 0;
+	int k;
+	for(k = 0; k < CALIBRATION_REPEATS; k++)
+	{
+		double start = MPI_Wtime();
+		apply_gate_block(portion, portion_size, 0, h, &mask);
+		double t = MPI_Wtime() - start;
+		if(k == 0 || t < best)
+			best = t;
+	}
+	return best;
+}
+
+int calibrate_costs(kernel_costs *costs, const size_t number_of_qubits)
+{
+	default_costs(costs);
+	complexd *portion = NULL;
+	int code = mymalloc(&portion, number_of_qubits);
+	if(code != SUCCESS)
+		return code;
+	const ulong portion_size = (1UL << number_of_qubits) / proc_num;
+	const double bytes = double(portion_size) * sizeof(complexd);
+	long i;
+	const long size = portion_size;
+	#pragma omp parallel for
+	for(i = 0; i < size; i++)
+		portion[i] = complexd(1.0, 0.0);
+	const int threads = omp_get_max_threads();
+	omp_set_num_threads(1);
+	costs->thread_bandwidth = bytes / time_sweep(portion, portion_size);
+	omp_set_num_threads(threads);
+	costs->memory_bandwidth = bytes / time_sweep(portion, portion_size);
+	if(proc_num > 1)
+	{
+		// как в transform: партнер отличается младшим битом номера процесса
+		const int partner = myrank ^ 1;
+		MPI_Status status;
+		int k;
+		double best = 0;
+		for(k = 0; k < CALIBRATION_REPEATS; k++)
+		{
+			MPI_Barrier(MPI_COMM_WORLD);
+			double start = MPI_Wtime();
+			MPI_Sendrecv_replace(portion, portion_size / 2, MPI_DOUBLE_COMPLEX, partner, NO_TAG, partner, NO_TAG, MPI_COMM_WORLD, &status);
+			double t = MPI_Wtime() - start;
+			if(k == 0 || t < best)
+				best = t;
+		}
+		MPI_Barrier(MPI_COMM_WORLD);
+		double start = MPI_Wtime();
+		for(k = 0; k < LATENCY_REPEATS; k++)
+			MPI_Sendrecv_replace(portion, 1, MPI_DOUBLE_COMPLEX, partner, NO_TAG, partner, NO_TAG, MPI_COMM_WORLD, &status);
+		costs->network_latency = (MPI_Wtime() - start) / LATENCY_REPEATS;
+		costs->network_bandwidth = bytes / 2 / std::max(best - costs->network_latency, 1e-9);
+	}
+	myfree(portion);
+	// худший процесс задерживает остальных
+	double bandwidths[3] = { costs->thread_bandwidth, costs->memory_bandwidth, costs->network_bandwidth };
+	MPI_Allreduce(MPI_IN_PLACE, bandwidths, 3, MPI_DOUBLE, MPI_MIN, MPI_COMM_WORLD);
+	MPI_Allreduce(MPI_IN_PLACE, &costs->network_latency, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+	costs->thread_bandwidth = bandwidths[0];
+	costs->memory_bandwidth = bandwidths[1];
+	costs->network_bandwidth = bandwidths[2];
+	return SUCCESS;
+}
+
+void estimate_init(circuit_estimate *estimate)
+{
+	memset(estimate, 0, sizeof(*estimate));
+}
+
+void estimate_circuit(const gate *gates, const size_t count, const size_t number_of_qubits, const int processes, const int threads,
+	const kernel_costs *costs, circuit_estimate *estimate)
+{
+	const double portion_bytes = std::ldexp(1.0, number_of_qubits) / processes * sizeof(complexd);
+	size_t sweeps = 0, exchanges = 0;
+	dense_circuit_cost(gates, count, number_of_qubits, processes, &sweeps, &exchanges);
+	estimate->gates += count;
+	estimate->sweeps += sweeps;
+	estimate->exchanges += exchanges;
+	// часть вектора и буфер для половины части при обмене
+	double memory = portion_bytes * (estimate->exchanges ? 1.5 : 1.0);
+	estimate->memory_per_process = std::max(estimate->memory_per_process, memory);
+	estimate->bytes_communicated += exchanges * processes * portion_bytes / 2;
+	const double sweep_bandwidth = std::min(threads * costs->thread_bandwidth, costs->memory_bandwidth);
+	estimate->sweep_seconds += sweeps * portion_bytes / sweep_bandwidth;
+	// обмен: сборка отдаваемой половины в буфер, пересылка и раскладка обратно
+	estimate->exchange_seconds += exchanges * (costs->network_latency + portion_bytes / 2 / costs->network_bandwidth + portion_bytes / sweep_bandwidth);
+}
@@ -1,5 +1,8 @@
 #include "functions.h"
+#include "manifest.h"
+#include "shm.h"
 #include <stdlib.h>
+#include <cstring>
 #include <iostream>
 #include <iomanip>
 #include <cmath>
@@ -8,7 +11,17 @@ int myrank, proc_num, i_am_the_master;
 
 void usage()
 {
-	printf("Usage: fidelity <input_file_1> <input_file_2> <number_of_qubits>");
+	printf("Usage: fidelity <input_file_1> <input_file_2> <number_of_qubits>\n");
+	printf("       fidelity --manifest <file>    lines \"<input_file_1> <input_file_2> <number_of_qubits>\"\n");
+	printf("       fidelity --shm <name_1> <name_2>    vectors left in shared memory by solve --shm\n");
+}
+
+int fidelity_job(const manifest_job &job, complexd **vectors, void *)
+{
+	double fid = fidelity(vectors[0], vectors[1], job.number_of_qubits);
+	if(i_am_the_master)
+		std::cout << "Fidelity: " << int(floor(fid*100)) << "% " << job.files[0] << ' ' << job.files[1] << std::endl;
+	return SUCCESS;
 }
 
 // Сравнивает два вектора, выводит процент сходства
@@ -19,7 +32,38 @@ int main(int argc, char **argv)
     MPI_Comm_rank (MPI_COMM_WORLD, &myrank);
     MPI_Comm_size (MPI_COMM_WORLD, &proc_num);
     i_am_the_master = myrank == MASTER;
-	if(argc != 4) {
+	if(argc == 3 && strcmp(argv[1], "--manifest") == 0) {
+		functions_init(myrank, proc_num, i_am_the_master);
+		std::vector<manifest_job> jobs;
+		if(read_manifest(argv[2], 2, jobs) == SUCCESS)
+			manifest_run(jobs, 2, 2, fidelity_job, NULL);
+		functions_clean();
+	}
+	else if(argc == 4 && strcmp(argv[1], "--shm") == 0) {
+		functions_init(myrank, proc_num, i_am_the_master);
+		// амплитуды читаются прямо из разделяемой памяти
+		shm_portion mapping_1, mapping_2;
+		size_t number_of_qubits_1 = 0, number_of_qubits_2 = 0;
+		if(shm_attach(argv[2], &number_of_qubits_1, &mapping_1) == SUCCESS)
+		{
+			if(shm_attach(argv[3], &number_of_qubits_2, &mapping_2) == SUCCESS)
+			{
+				if(number_of_qubits_1 != number_of_qubits_2) {
+					if(i_am_the_master)
+						printf("Vectors have %zu and %zu qubits\n", number_of_qubits_1, number_of_qubits_2);
+				}
+				else {
+					double fid = fidelity(mapping_1.portion, mapping_2.portion, number_of_qubits_1);
+					if(i_am_the_master)
+						std::cout << "Fidelity: " << int(floor(fid*100)) << '%' << std::endl;
+				}
+				shm_detach(&mapping_2);
+			}
+			shm_detach(&mapping_1);
+		}
+		functions_clean();
+	}
+	else if(argc != 4) {
 		if(i_am_the_master)
 			usage();
 	}
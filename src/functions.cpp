@@ -8,6 +8,9 @@
 #include <math.h>
 #include <errno.h>
 #include <stdio.h>
+#include <map>
+#include <algorithm>
+#include <vector>
 
 double **adamar_matrix = NULL;
 complexd **U = NULL;
@@ -114,8 +117,67 @@ int mymalloc(complexd **_portion, const size_t number_of_qubits)
 	return SUCCESS;
 }
 
+// Карта занятости кусков вектора: occupied[c] == 0, если все элементы куска c нулевые.
+// Ядра поддерживают ее сами, поэтому нулевые куски не читаются и не пересылаются
+struct zero_map
+{
+	ulong portion_size;
+	ulong chunk_size;
+	std::vector<unsigned char> occupied;
+};
+static std::map<const complexd *, zero_map> zero_maps;
+const ulong zero_chunk_size = 1024;
+
+static zero_map *zero_map_of(const complexd *portion)
+{
+	std::map<const complexd *, zero_map>::iterator it = zero_maps.find(portion);
+	if(it == zero_maps.end())
+		return NULL;
+	return &it->second;
+}
+
+static bool chunk_is_zero(const complexd *chunk, const ulong chunk_size)
+{
+	ulong i;
+	for(i = 0; i < chunk_size; i++)
+		if(chunk[i] != 0.0)
+			return false;
+	return true;
+}
+
+void zero_tracking_refresh(const complexd *portion)
+{
+	zero_map *zm = zero_map_of(portion);
+	if(zm == NULL)
+		return;
+	long c;
+	const long chunks = zm->occupied.size();
+	#pragma omp parallel for
+	for(c = 0; c < chunks; c++)
+		zm->occupied[c] = !chunk_is_zero(portion + c*zm->chunk_size, zm->chunk_size);
+}
+
+int zero_tracking_attach(const complexd *portion, const size_t number_of_qubits)
+{
+	if(portion == NULL)
+		return WRONG_VALUE;
+	zero_map &zm = zero_maps[portion];
+	zm.portion_size = (1UL << number_of_qubits) / proc_num;
+	// половина части должна состоять из целых кусков: в transform ей обмениваются с партнером
+	zm.chunk_size = zm.portion_size / 2 < zero_chunk_size ? std::max(zm.portion_size / 2, 1UL) : zero_chunk_size;
+	zm.occupied.assign(zm.portion_size / zm.chunk_size, 1);
+	zero_tracking_refresh(portion);
+	return SUCCESS;
+}
+
+void zero_tracking_detach(const complexd *portion)
+{
+	zero_maps.erase(portion);
+}
+
 void myfree(complexd *portion)
 {
+	zero_tracking_detach(portion);
 	delete [] portion;
 }
 void myfree_f(complexd *portion)
@@ -203,7 +265,18 @@ complexd dot(const complexd *portion1, const complexd *portion2, const size_t nu
 	ulong portion_size = (1 << number_of_qubits) / proc_num;
 	ulong i;
 	complexd sum = 0;
+	zero_map *zm1 = zero_map_of(portion1);
+	zero_map *zm2 = zero_map_of(portion2);
 	for(i = 0; i < portion_size; i++) {
+		// нулевой кусок любого из векторов ничего не добавляет
+		if(zm1 && i % zm1->chunk_size == 0 && !zm1->occupied[i / zm1->chunk_size]) {
+			i += zm1->chunk_size - 1;
+			continue;
+		}
+		if(zm2 && i % zm2->chunk_size == 0 && !zm2->occupied[i / zm2->chunk_size]) {
+			i += zm2->chunk_size - 1;
+			continue;
+		}
 		sum += portion1[i] * std::conj(portion2[i]);
 	}
 	complexd sum_dot(0.,0.);
@@ -217,8 +290,14 @@ double norm(const complexd *portion, const size_t number_of_qubits)
 	ulong portion_size = (1 << number_of_qubits) / proc_num;
 	ulong i;
 	double sum_of_squares = 0;
-	for(i = 0; i < portion_size; i++)
+	zero_map *zm = zero_map_of(portion);
+	for(i = 0; i < portion_size; i++) {
+		if(zm && i % zm->chunk_size == 0 && !zm->occupied[i / zm->chunk_size]) {
+			i += zm->chunk_size - 1;
+			continue;
+		}
 		sum_of_squares += std::abs(portion[i] * portion[i]);
+	}
 	double all_sum = 0;
 	MPI_Reduce(&sum_of_squares, &all_sum, 1, MPI_DOUBLE, MPI_SUM, MASTER, MPI_COMM_WORLD);
 	MPI_Bcast(&all_sum, 1, MPI_DOUBLE, MASTER, MPI_COMM_WORLD);
@@ -257,6 +336,7 @@ int generate_state(complexd *portion, const size_t number_of_qubits)
 	for(i = 0; i < portion_size; i++) {
 		portion[i] = complexd(rand() / (RAND_MAX + 0.0) - .5, rand() / (RAND_MAX + 0.0) - .5);
 	}
+	zero_tracking_refresh(portion);
 	double sum_norm = norm(portion, number_of_qubits);
 	for(i = 0; i < portion_size; i++) {
 		portion[i] /= sum_norm;
@@ -280,7 +360,8 @@ int generate_state_f(complexd *portion, const size_t number_of_qubits)
 }
 
 
-int two_qubit_transform_f(complexd *portion, const size_t number_of_qubits, const size_t first_qubit, const size_t second_qubit)
+// all_occupied - карты занятости всех частей, собранные вместе; zm - карта части этого процесса, она обновляется
+int two_qubit_transform_f(complexd *portion, const size_t number_of_qubits, const size_t first_qubit, const size_t second_qubit, zero_map *zm = NULL, const unsigned char *all_occupied = NULL)
 {
 	#if DEBUG
 	if(i_am_the_master)
@@ -311,20 +392,53 @@ int two_qubit_transform_f(complexd *portion, const size_t number_of_qubits, cons
 	ulong test_q1 = 1<<shift1;
 	//Все биты нулевые, за исключением соответсвующего номеру второго изменяемого кубита
 	ulong test_q2 = 1<<shift2;
-	#pragma omp parallel for
-	for(i = start_pos; i < start_pos+chunk_size; i++)
+	if(zm != NULL)
 	{
-		//Установка изменяемых битов во все возможные позиции
-		ulong i00 = i & ~test_q1 & ~test_q2;
-		ulong i01 = i & ~test_q1 | test_q2;
-		ulong i10 = (i | test_q1) & ~test_q2;
-		ulong i11 = i | test_q1 | test_q2;
-		//Получение значений изменяемых битов
-		int iq1 = (i & test_q1) >> shift1;
-		int iq2 = (i & test_q2) >> shift2;
-		//Номер столбца в матрице
-		int iq=(iq1<<1)+iq2;
-		out[i-start_pos] = U[0][iq] * portion[i00] + U[1][iq] * portion[i01] + U[2][iq] * portion[i10] + U[3][iq] * portion[i11];
+		// по кускам: если все четыре куска-источника нулевые, результат тоже нулевой
+		const ulong zc = zm->chunk_size;
+		long c;
+		const long chunks = chunk_size / zc;
+		#pragma omp parallel for
+		for(c = 0; c < chunks; c++)
+		{
+			ulong base = start_pos + c*zc;
+			complexd *out_chunk = out + c*zc;
+			if(!all_occupied[(base & ~test_q1 & ~test_q2) / zc] && !all_occupied[((base & ~test_q1) | test_q2) / zc] &&
+			   !all_occupied[((base | test_q1) & ~test_q2) / zc] && !all_occupied[(base | test_q1 | test_q2) / zc])
+			{
+				std::fill(out_chunk, out_chunk + zc, complexd(0));
+				zm->occupied[c] = 0;
+				continue;
+			}
+			ulong j;
+			bool nonzero = false;
+			for(j = base; j < base + zc; j++)
+			{
+				int iq = (((j & test_q1) >> shift1) << 1) + ((j & test_q2) >> shift2);
+				out_chunk[j-base] = U[0][iq] * portion[j & ~test_q1 & ~test_q2] + U[1][iq] * portion[(j & ~test_q1) | test_q2] +
+				                    U[2][iq] * portion[(j | test_q1) & ~test_q2] + U[3][iq] * portion[j | test_q1 | test_q2];
+				nonzero = nonzero || out_chunk[j-base] != 0.0;
+			}
+			zm->occupied[c] = nonzero;
+		}
+	}
+	else
+	{
+		#pragma omp parallel for
+		for(i = start_pos; i < start_pos+chunk_size; i++)
+		{
+			//Установка изменяемых битов во все возможные позиции
+			ulong i00 = i & ~test_q1 & ~test_q2;
+			ulong i01 = i & ~test_q1 | test_q2;
+			ulong i10 = (i | test_q1) & ~test_q2;
+			ulong i11 = i | test_q1 | test_q2;
+			//Получение значений изменяемых битов
+			int iq1 = (i & test_q1) >> shift1;
+			int iq2 = (i & test_q2) >> shift2;
+			//Номер столбца в матрице
+			int iq=(iq1<<1)+iq2;
+			out[i-start_pos] = U[0][iq] * portion[i00] + U[1][iq] * portion[i01] + U[2][iq] * portion[i10] + U[3][iq] * portion[i11];
+		}
 	}
 	// После преобразования на 0 процессе будет преобразованный вектор
 	int code = MPI_Gather(out, chunk_size, MPI_DOUBLE_COMPLEX, portion, chunk_size, MPI_DOUBLE_COMPLEX, MASTER, MPI_COMM_WORLD);
@@ -353,8 +467,15 @@ int two_qubit_transform(complexd *portion, const size_t number_of_qubits, const
 	}
 	// собираем вектор на каждом процессе
 	MPI_Allgather(portion, portion_size, MPI_DOUBLE_COMPLEX, all_portions, portion_size, MPI_DOUBLE_COMPLEX, MPI_COMM_WORLD);
+	// и карты нулевых кусков, если они ведутся
+	zero_map *zm = zero_map_of(portion);
+	std::vector<unsigned char> all_occupied;
+	if(zm != NULL) {
+		all_occupied.resize(zm->occupied.size() * proc_num);
+		MPI_Allgather(zm->occupied.data(), zm->occupied.size(), MPI_UNSIGNED_CHAR, all_occupied.data(), zm->occupied.size(), MPI_UNSIGNED_CHAR, MPI_COMM_WORLD);
+	}
 	// преобразуем
-	code = two_qubit_transform_f(all_portions, number_of_qubits, first_qubit, second_qubit);
+	code = two_qubit_transform_f(all_portions, number_of_qubits, first_qubit, second_qubit, zm, all_occupied.data());
 	if(code != SUCCESS) {
 		Printer::error("Двухкубитное преобразование не выполнено");
 		return code;
@@ -462,6 +583,7 @@ int qft_transform_by_transposition(complexd *portion, const size_t number_of_qub
 		}
 	// раздаем новый вектор, освобождая его
 	scatter_vector(buffer, portion, number_of_qubits);
+	zero_tracking_refresh(portion);
 	// старый больше не нужен
 	if(i_am_the_master)
 		myfree_f(all_portions);
@@ -470,6 +592,69 @@ int qft_transform_by_transposition(complexd *portion, const size_t number_of_qub
 	return SUCCESS;
 }
 
+// Пары (i, i|mask) по кускам: пары нулевых кусков пропускаются, занятость пересчитывается по результату
+static void transform_pairs_tracked(complexd *portion, const ulong portion_size, const ulong mask, double **transform_matrix, zero_map *zm)
+{
+	const ulong zc = zm->chunk_size;
+	const long chunks = portion_size / zc;
+	long c;
+	#pragma omp parallel for
+	for(c = 0; c < chunks; c++)
+	{
+		// пары внутри куска, если mask < zc, иначе пара кусков c и c|mask/zc
+		const long partner = mask >= zc ? (c | long(mask / zc)) : c;
+		if((mask >= zc && (c & long(mask / zc))) || (!zm->occupied[c] && !zm->occupied[partner]))
+			continue;
+		complexd *first = portion + c*zc;
+		complexd *second = portion + partner*zc;
+		const ulong step = mask >= zc ? 0 : mask;
+		bool nonzero1 = false, nonzero2 = false;
+		ulong j;
+		for(j = 0; j < zc; j++)
+		{
+			if(step && (j & step))
+				continue;
+			complexd value1 = first[j];
+			complexd value2 = second[j + step];
+			first[j] = value1*transform_matrix[0][0] + value2*transform_matrix[1][0];
+			second[j + step] = value1*transform_matrix[0][1] + value2*transform_matrix[1][1];
+			nonzero1 = nonzero1 || first[j] != 0.0;
+			nonzero2 = nonzero2 || second[j + step] != 0.0;
+		}
+		zm->occupied[c] = nonzero1 || (partner == c && nonzero2);
+		if(partner != c)
+			zm->occupied[partner] = nonzero2;
+	}
+}
+
+// Обмен половиной части с партнером. Сначала обмениваемся картами занятости половин:
+// нулевая половина не пересылается, получатель сам заполняет ее нулями
+static int sendrecv_half(complexd *portion, complexd *half, const ulong half_size, const int partner, zero_map *zm)
+{
+	MPI_Status status;
+	if(zm == NULL)
+		return MPI_Sendrecv_replace(half, half_size, MPI_DOUBLE_COMPLEX, partner, NO_TAG, partner, NO_TAG, MPI_COMM_WORLD, &status);
+	const ulong first_chunk = (half - portion) / zm->chunk_size;
+	const ulong half_chunks = half_size / zm->chunk_size;
+	unsigned char *mine = zm->occupied.data() + first_chunk;
+	std::vector<unsigned char> theirs(half_chunks);
+	MPI_Sendrecv(mine, half_chunks, MPI_UNSIGNED_CHAR, partner, NO_TAG, theirs.data(), half_chunks, MPI_UNSIGNED_CHAR, partner, NO_TAG, MPI_COMM_WORLD, &status);
+	bool mine_zero = std::count(mine, mine + half_chunks, 0) == (long)half_chunks;
+	bool theirs_zero = std::count(theirs.begin(), theirs.end(), 0) == (long)half_chunks;
+	int code = MPI_SUCCESS;
+	if(!mine_zero && !theirs_zero)
+		code = MPI_Sendrecv_replace(half, half_size, MPI_DOUBLE_COMPLEX, partner, NO_TAG, partner, NO_TAG, MPI_COMM_WORLD, &status);
+	else if(!mine_zero)
+	{
+		code = MPI_Send(half, half_size, MPI_DOUBLE_COMPLEX, partner, NO_TAG, MPI_COMM_WORLD);
+		std::fill(half, half + half_size, complexd(0));
+	}
+	else if(!theirs_zero)
+		code = MPI_Recv(half, half_size, MPI_DOUBLE_COMPLEX, partner, NO_TAG, MPI_COMM_WORLD, &status);
+	std::copy(theirs.begin(), theirs.end(), mine);
+	return code;
+}
+
 int transform(complexd *portion, const size_t number_of_qubits, const size_t qubit_num, double **transform_matrix)
 {
 	#if DEBUG
@@ -494,6 +679,8 @@ int transform(complexd *portion, const size_t number_of_qubits, const size_t qub
 	ulong processes_per_part = proc_num / parts_num;
 	// Each process has a portion of state vector
 	ulong portion_size = size / proc_num;
+	// Нулевые куски не обрабатываются, если для вектора ведется карта занятости
+	zero_map *zm = zero_map_of(portion);
 	#if DEBUG
 	if(i_am_the_master) {
 		printf("Общий размер: %lu\n", size);
@@ -517,27 +704,30 @@ int transform(complexd *portion, const size_t number_of_qubits, const size_t qub
 			sendrecv_buffer = portion;
 		else
 			sendrecv_buffer = portion + portion_size / 2;
-		MPI_Status temp;
 		int dest = myrank^processes_per_part;
-		int source = dest;
 		// Printer::debug(std::to_string(myrank)+std::string(" -- ")+std::to_string(dest));
-		MPI_Sendrecv_replace(sendrecv_buffer, portion_size/2, MPI_DOUBLE_COMPLEX, dest, NO_TAG, source, NO_TAG, MPI_COMM_WORLD, &temp);
+		sendrecv_half(portion, sendrecv_buffer, portion_size/2, dest, zm);
 		if(i_am_the_master)
 			Printer::debug("Раздали половинки");
 		// Transform first half of the vector with the second half
-		#pragma omp parallel for
-		for(i = 0; i < portion_size/2; i++) {
-			ulong index1 = i;
-			ulong index2 = i+portion_size/2;
-			complexd value1 = portion[index1];
-			complexd value2 = portion[index2];
-			portion[index1] = value1*transform_matrix[0][0] + value2*transform_matrix[1][0];
-			portion[index2] = value1*transform_matrix[0][1] + value2*transform_matrix[1][1];
+		if(zm != NULL)
+			transform_pairs_tracked(portion, portion_size, portion_size/2, transform_matrix, zm);
+		else
+		{
+			#pragma omp parallel for
+			for(i = 0; i < portion_size/2; i++) {
+				ulong index1 = i;
+				ulong index2 = i+portion_size/2;
+				complexd value1 = portion[index1];
+				complexd value2 = portion[index2];
+				portion[index1] = value1*transform_matrix[0][0] + value2*transform_matrix[1][0];
+				portion[index2] = value1*transform_matrix[0][1] + value2*transform_matrix[1][1];
+			}
 		}
 		if(i_am_the_master)
 			Printer::debug("Преобразовали");
 		// We need an extra Sendrecv operation to restore order
-		MPI_Sendrecv_replace(sendrecv_buffer, portion_size/2, MPI_DOUBLE_COMPLEX, dest, NO_TAG, source, NO_TAG, MPI_COMM_WORLD, &temp);
+		sendrecv_half(portion, sendrecv_buffer, portion_size/2, dest, zm);
 		if(i_am_the_master)
 			Printer::debug("Раздали половинки обратно");
 	}
@@ -552,17 +742,22 @@ int transform(complexd *portion, const size_t number_of_qubits, const size_t qub
 			Printer::debug(std::to_string(parts_num / proc_num / 2), "Пар на один процесс");
 			assert((0|mask) < portion_size);
 		}
-		#pragma omp parallel for
-		for(i = 0; i < portion_size; i++)
-			if((i & mask) != mask)
-			{
-				ulong index1 = i;
-				ulong index2 = i|mask;
-				complexd value1 = portion[index1];
-				complexd value2 = portion[index2];
-				portion[index1] = value1*transform_matrix[0][0] + value2*transform_matrix[1][0];
-				portion[index2] = value1*transform_matrix[0][1] + value2*transform_matrix[1][1];
-			}
+		if(zm != NULL)
+			transform_pairs_tracked(portion, portion_size, mask, transform_matrix, zm);
+		else
+		{
+			#pragma omp parallel for
+			for(i = 0; i < portion_size; i++)
+				if((i & mask) != mask)
+				{
+					ulong index1 = i;
+					ulong index2 = i|mask;
+					complexd value1 = portion[index1];
+					complexd value2 = portion[index2];
+					portion[index1] = value1*transform_matrix[0][0] + value2*transform_matrix[1][0];
+					portion[index2] = value1*transform_matrix[0][1] + value2*transform_matrix[1][1];
+				}
+		}
 	}
 	// MPI_Barrier(MPI_COMM_WORLD);
 	if(i_am_the_master)
@@ -674,6 +869,14 @@ complexd *copy_state(complexd *copy_from, const size_t number_of_qubits)
 	return copy_to;
 }
 
+// Коды бывают и отрицательными, и errno, поэтому сводится признак неудачи, а не сами коды
+int collective_code(const int code)
+{
+	int failed = code != SUCCESS;
+	MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+	return failed && code == SUCCESS ? NOT_SUCCESS : code;
+}
+
 int read_vector_from_file(complexd *portion, size_t number_of_qubits, const char *filename)
 {
 	if(i_am_the_master) Printer::debug("Reading from file", filename);
@@ -717,6 +920,7 @@ int read_vector_from_file(complexd *portion, size_t number_of_qubits, const char
 	}
 	// рутовый процесс раздает части вектора по процессам
 	scatter_vector(all_portions, portion, number_of_qubits);
+	zero_tracking_refresh(portion);
 	MPI_Barrier(MPI_COMM_WORLD);
 	return SUCCESS;
 }
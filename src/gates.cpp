@@ -0,0 +1,663 @@
+#include "gates.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+
+static const double pi = std::acos(-1);
+
+gate make_gate1(const int type, const size_t q1, const double param)
+{
+	gate g;
+	g.type = type;
+	g.qubits_num = 1;
+	g.qubits[0] = q1;
+	g.qubits[1] = g.qubits[2] = 0;
+	g.param = param;
+	return g;
+}
+
+gate make_gate2(const int type, const size_t q1, const size_t q2, const double param)
+{
+	gate g = make_gate1(type, q1, param);
+	g.qubits_num = 2;
+	g.qubits[1] = q2;
+	return g;
+}
+
+gate make_gate3(const int type, const size_t q1, const size_t q2, const size_t q3)
+{
+	gate g = make_gate2(type, q1, q2);
+	g.qubits_num = 3;
+	g.qubits[2] = q3;
+	return g;
+}
+
+bool gate_is_diagonal(const gate &g)
+{
+	return g.type == GATE_Z || g.type == GATE_RZ || g.type == GATE_CP;
+}
+
+bool gate_is_diagonal_on(const gate &g, const size_t q)
+{
+	if(gate_is_diagonal(g))
+		return true;
+	if(g.type == GATE_CX)
+		return g.qubits[0] == q;
+	if(g.type == GATE_CCX)
+		return g.qubits[0] == q || g.qubits[1] == q;
+	return false;
+}
+
+void gate_masks(const gate &g, const size_t number_of_qubits, const int *bit_of, ulong *masks)
+{
+	size_t k;
+	for(k = 0; k < g.qubits_num; k++)
+	{
+		int bit = bit_of ? bit_of[g.qubits[k]] : int(number_of_qubits - g.qubits[k]);
+		masks[k] = 1UL << bit;
+	}
+}
+
+ulong gate_target_mask(const gate &g, const ulong *masks)
+{
+	switch(g.type)
+	{
+		case GATE_H:
+		case GATE_X:
+		case GATE_RX:
+			return masks[0];
+		case GATE_CX:
+			return masks[1];
+		case GATE_CCX:
+			return masks[2];
+		case GATE_SWAP:
+			return masks[0] | masks[1];
+		default:
+			// диагональные вентили и измерение не перемешивают амплитуды
+			return 0;
+	}
+}
+
+// Матрица 2x2 (m[0][0], m[0][1], m[1][0], m[1][1]) на целевом бите, если все биты control установлены.
+// У каждого индекса states амплитуд подряд (по одной от каждого вектора пачки)
+static void apply_matrix_block(complexd *block, const ulong block_size, const ulong first_index, const ulong target, const ulong control, const complexd m[4], const size_t states)
+{
+	long i;
+	const long pairs = block_size / 2;
+	#pragma omp parallel for
+	for(i = 0; i < pairs; i++)
+	{
+		ulong index1 = insert_zero(i, target);
+		if(((first_index | index1) & control) != control)
+			continue;
+		complexd *value1 = block + index1 * states;
+		complexd *value2 = block + (index1 | target) * states;
+		size_t s;
+		for(s = 0; s < states; s++)
+		{
+			complexd v1 = value1[s];
+			complexd v2 = value2[s];
+			value1[s] = m[0]*v1 + m[1]*v2;
+			value2[s] = m[2]*v1 + m[3]*v2;
+		}
+	}
+}
+
+static inline void swap_states(complexd *a, complexd *b, const size_t states)
+{
+	size_t s;
+	for(s = 0; s < states; s++)
+		std::swap(a[s], b[s]);
+}
+
+static void apply_swap_block(complexd *block, const ulong block_size, const ulong first_index, const ulong target, const ulong control, const size_t states)
+{
+	long i;
+	const long pairs = block_size / 2;
+	#pragma omp parallel for
+	for(i = 0; i < pairs; i++)
+	{
+		ulong index1 = insert_zero(i, target);
+		if(((first_index | index1) & control) != control)
+			continue;
+		swap_states(block + index1 * states, block + (index1 | target) * states, states);
+	}
+}
+
+// Фаза e^{i*phi} у всех элементов, где установлены все биты mask; phase0 - где хотя бы одного нет
+static void apply_phase_block(complexd *block, const ulong block_size, const ulong first_index, const ulong mask, const complexd phase0, const complexd phase1, const size_t states)
+{
+	long i;
+	const long size = block_size;
+	#pragma omp parallel for
+	for(i = 0; i < size; i++)
+	{
+		const complexd phase = (((first_index | i) & mask) == mask) ? phase1 : phase0;
+		complexd *values = block + i * states;
+		size_t s;
+		for(s = 0; s < states; s++)
+			values[s] *= phase;
+	}
+}
+
+int apply_gate_block(complexd *block, const ulong block_size, const ulong first_index, const gate &g, const ulong *masks, const size_t states)
+{
+	if(gate_target_mask(g, masks) >= block_size)
+	{
+		fprintf(stderr, "%s\n", "Gate target is outside of the block");
+		return WRONG_VALUE;
+	}
+	const double r = 1.0/sqrt(2);
+	const complexd i_unit(0, 1);
+	complexd m[4];
+	switch(g.type)
+	{
+		case GATE_H:
+			m[0] = r; m[1] = r; m[2] = r; m[3] = -r;
+			apply_matrix_block(block, block_size, first_index, masks[0], 0, m, states);
+			break;
+		case GATE_X:
+			apply_swap_block(block, block_size, first_index, masks[0], 0, states);
+			break;
+		case GATE_RX:
+			m[0] = m[3] = cos(g.param/2);
+			m[1] = m[2] = -i_unit * sin(g.param/2);
+			apply_matrix_block(block, block_size, first_index, masks[0], 0, m, states);
+			break;
+		case GATE_CX:
+			apply_swap_block(block, block_size, first_index, masks[1], masks[0], states);
+			break;
+		case GATE_CCX:
+			apply_swap_block(block, block_size, first_index, masks[2], masks[0] | masks[1], states);
+			break;
+		case GATE_SWAP:
+		{
+			// меняем местами элементы 01 и 10: пробегаем индексы с нулем в старшем из двух битов
+			long i;
+			const ulong high = std::max(masks[0], masks[1]);
+			const ulong low = std::min(masks[0], masks[1]);
+			const long pairs = block_size / 2;
+			#pragma omp parallel for
+			for(i = 0; i < pairs; i++)
+			{
+				ulong index1 = insert_zero(i, high);
+				if(index1 & low)
+					swap_states(block + index1 * states, block + ((index1 ^ low) | high) * states, states);
+			}
+			break;
+		}
+		case GATE_Z:
+			apply_phase_block(block, block_size, first_index, masks[0], 1, -1, states);
+			break;
+		case GATE_RZ:
+			apply_phase_block(block, block_size, first_index, masks[0], std::exp(-i_unit*g.param/2.0), std::exp(i_unit*g.param/2.0), states);
+			break;
+		case GATE_CP:
+			apply_phase_block(block, block_size, first_index, masks[0] | masks[1], 1, std::exp(i_unit*g.param), states);
+			break;
+		default:
+			fprintf(stderr, "%s\n", "Unsupported gate");
+			return WRONG_VALUE;
+	}
+	return SUCCESS;
+}
+
+// Меняет местами бит номера процесса rank_mask и локальный бит local_mask: как в transform,
+// процесс отдает партнеру элементы, у которых локальный бит не совпадает с его битом номера.
+// У каждого индекса states амплитуд подряд, они пересылаются одним сообщением
+static int exchange_bit(complexd *portion, const ulong portion_size, const ulong local_mask, const int rank_mask, const size_t states = 1)
+{
+	const int partner = myrank ^ rank_mask;
+	const ulong my_value = (myrank & rank_mask) ? local_mask : 0;
+	const long pairs = portion_size / 2;
+	MPI_Status status;
+	int code;
+	if(local_mask == portion_size / 2)
+	{
+		// старший локальный бит: отдаваемая половина лежит подряд
+		complexd *half = my_value ? portion : portion + pairs * states;
+		code = MPI_Sendrecv_replace(half, pairs * states, MPI_DOUBLE_COMPLEX, partner, NO_TAG, partner, NO_TAG, MPI_COMM_WORLD, &status);
+	}
+	else
+	{
+		complexd *buffer = NULL;
+		try
+		{
+			buffer = new complexd [pairs * states];
+		}
+		catch (std::bad_alloc& ba)
+		{
+			fprintf(stderr, "%s\n", "Failed to allocate exchange buffer");
+			return NO_MEMORY;
+		}
+		long i;
+		#pragma omp parallel for
+		for(i = 0; i < pairs; i++)
+			std::copy(portion + (insert_zero(i, local_mask) | (my_value ^ local_mask)) * states, portion + ((insert_zero(i, local_mask) | (my_value ^ local_mask)) + 1) * states, buffer + i * states);
+		code = MPI_Sendrecv_replace(buffer, pairs * states, MPI_DOUBLE_COMPLEX, partner, NO_TAG, partner, NO_TAG, MPI_COMM_WORLD, &status);
+		#pragma omp parallel for
+		for(i = 0; i < pairs; i++)
+			std::copy(buffer + i * states, buffer + (i + 1) * states, portion + (insert_zero(i, local_mask) | (my_value ^ local_mask)) * states);
+		delete [] buffer;
+	}
+	return code == MPI_SUCCESS ? SUCCESS : code;
+}
+
+// Генератор исходов измерений, используется только рутовым процессом. Собственный генератор, а не rand():
+// при заданном зерне исходы не зависят от числа процессов и от других потребителей rand()
+static std::mt19937_64 measurement_generator;
+static bool measurement_seeded = false;
+
+void measurement_seed(const ulong seed)
+{
+	measurement_generator.seed(seed);
+	measurement_seeded = true;
+}
+
+// 53 старших бита, одинаково во всех реализациях стандартной библиотеки
+double measurement_uniform()
+{
+	if(!measurement_seeded)
+		measurement_seed(rand());
+	return (measurement_generator() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Измерение бита mask глобального индекса: проход с вероятностями, MPI_Allreduce и проход, обнуляющий
+// отброшенную половину и нормирующий оставшуюся. Если бит глобальный, часть процесса целиком в одной половине:
+// вероятность - просто норма части, а процессы с отброшенной половиной только обнуляют ее
+static int measure_mask(complexd *portion, const ulong portion_size, const ulong mask, int *outcome)
+{
+	const ulong first_index = myrank * portion_size;
+	const bool global = mask >= portion_size;
+	long i;
+	const long size = portion_size, pairs = portion_size / 2;
+	double probabilities[2] = { 0, 0 }, all_probabilities[2];
+	double p0 = 0, p1 = 0;
+	if(global)
+	{
+		#pragma omp parallel for reduction(+:p0)
+		for(i = 0; i < size; i++)
+			p0 += std::norm(portion[i]);
+		probabilities[(first_index & mask) != 0] = p0;
+	}
+	else
+	{
+		#pragma omp parallel for reduction(+:p0,p1)
+		for(i = 0; i < pairs; i++)
+		{
+			const ulong index0 = insert_zero(i, mask);
+			p0 += std::norm(portion[index0]);
+			p1 += std::norm(portion[index0 | mask]);
+		}
+		probabilities[0] = p0;
+		probabilities[1] = p1;
+	}
+	MPI_Allreduce(probabilities, all_probabilities, 2, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+	int result = 0;
+	if(i_am_the_master)
+		result = measurement_uniform() * (all_probabilities[0] + all_probabilities[1]) < all_probabilities[1];
+	MPI_Bcast(&result, 1, MPI_INT, MASTER, MPI_COMM_WORLD);
+	// оставляем половину с выпавшим значением и нормируем ее
+	const ulong kept = result ? mask : 0;
+	const double scale = 1.0 / sqrt(all_probabilities[result]);
+	if(global)
+	{
+		if((first_index & mask) == kept)
+		{
+			#pragma omp parallel for
+			for(i = 0; i < size; i++)
+				portion[i] *= scale;
+		}
+		else
+			std::fill(portion, portion + portion_size, complexd(0));
+	}
+	else
+	{
+		#pragma omp parallel for
+		for(i = 0; i < pairs; i++)
+		{
+			const ulong index0 = insert_zero(i, mask);
+			portion[index0 | kept] *= scale;
+			portion[(index0 | mask) ^ kept] = 0;
+		}
+	}
+	if(outcome != NULL)
+		*outcome = result;
+	return SUCCESS;
+}
+
+size_t log2_of(ulong v)
+{
+	size_t r = 0;
+	while(v >>= 1)
+		r++;
+	return r;
+}
+
+void layout_init(qubit_layout *layout, const size_t number_of_qubits, const ulong portion_size)
+{
+	layout->number_of_qubits = number_of_qubits;
+	layout->local_bits = log2_of(portion_size);
+	size_t q;
+	for(q = 1; q <= number_of_qubits; q++)
+	{
+		layout->bit_of[q] = number_of_qubits - q;
+		layout->qubit_at[number_of_qubits - q] = q;
+	}
+}
+
+void layout_swap(qubit_layout *layout, const int bit1, const int bit2)
+{
+	int q1 = layout->qubit_at[bit1];
+	int q2 = layout->qubit_at[bit2];
+	layout->qubit_at[bit1] = q2;
+	layout->qubit_at[bit2] = q1;
+	layout->bit_of[q1] = bit2;
+	layout->bit_of[q2] = bit1;
+}
+
+ulong layout_target_mask(const qubit_layout *layout, const gate &g)
+{
+	ulong masks[GATE_MAX_QUBITS];
+	gate_masks(g, layout->number_of_qubits, layout->bit_of, masks);
+	return gate_target_mask(g, masks);
+}
+
+int layout_victim(const qubit_layout *layout, const gate *gates, const size_t count, const ulong busy)
+{
+	ulong candidates = ((1UL << layout->local_bits) - 1) & ~busy;
+	size_t i;
+	for(i = 0; i < count && candidates; i++)
+	{
+		ulong used = layout_target_mask(layout, gates[i]) & candidates;
+		if(used == candidates)
+			break;
+		candidates &= ~used;
+	}
+	if(!candidates)
+		return -1;
+	// среди оставшихся берем младший: пришедший на его место кубит попадет в кусок DENSE_CACHE_BITS
+	return log2_of(candidates & -candidates);
+}
+
+// Меняет местами локальные биты mask1 < mask2
+static void swap_local_bits(complexd *portion, const ulong portion_size, const ulong mask1, const ulong mask2, const size_t states)
+{
+	long i;
+	const long quarter = portion_size / 4;
+	#pragma omp parallel for
+	for(i = 0; i < quarter; i++)
+	{
+		ulong index = insert_zero(insert_zero(i, mask1), mask2);
+		swap_states(portion + (index | mask1) * states, portion + (index | mask2) * states, states);
+	}
+}
+
+// Меняет местами биты a и b индекса вектора (portion == NULL - только расположение) и считает стоимость
+static int swap_bits(complexd *portion, const size_t states, qubit_layout *layout, int a, int b, size_t *sweeps, size_t *exchanges)
+{
+	if(a > b)
+		std::swap(a, b);
+	const int local_bits = layout->local_bits;
+	const ulong portion_size = 1UL << local_bits;
+	int code = SUCCESS;
+	if(a >= local_bits)
+	{
+		// оба бита - номер процесса: (a b) = (0 a)(0 b)(0 a)
+		if(local_bits == 0)
+		{
+			fprintf(stderr, "%s\n", "Not enough local qubits for the gate");
+			return WRONG_VALUE;
+		}
+		code = swap_bits(portion, states, layout, 0, a, sweeps, exchanges);
+		if(code == SUCCESS)
+			code = swap_bits(portion, states, layout, 0, b, sweeps, exchanges);
+		if(code == SUCCESS)
+			code = swap_bits(portion, states, layout, 0, a, sweeps, exchanges);
+		return code;
+	}
+	if(b < local_bits)
+	{
+		(*sweeps)++;
+		if(portion != NULL)
+			swap_local_bits(portion, portion_size, 1UL << a, 1UL << b, states);
+	}
+	else
+	{
+		(*exchanges)++;
+		if(portion != NULL)
+			code = exchange_bit(portion, portion_size, 1UL << a, 1 << (b - local_bits), states);
+	}
+	if(code == SUCCESS)
+		layout_swap(layout, a, b);
+	return code;
+}
+
+// Меньше стольких кусков группы не собираются: часть вектора и так помещается в кэш,
+// а параллельно обрабатываются именно куски
+#define DENSE_GROUP_MIN_CHUNKS 64
+
+ulong dense_cache_size(const ulong portion_size, const size_t states)
+{
+	// кусок занимает столько же памяти, сколько при одном векторе
+	ulong cache_size = 1UL << DENSE_CACHE_BITS;
+	while(cache_size > 1 && cache_size * states > (1UL << DENSE_CACHE_BITS))
+		cache_size >>= 1;
+	return portion_size / cache_size >= DENSE_GROUP_MIN_CHUNKS ? cache_size : portion_size;
+}
+
+// Вентили с целевыми битами меньше cache_size за один проход: каждый кусок проходит все вентили группы
+static void apply_group(complexd *portion, const size_t states, const ulong portion_size, const ulong cache_size, const qubit_layout *layout, const gate *gates, const size_t count)
+{
+	const ulong first_index = myrank * portion_size;
+	std::vector<ulong> masks(count * GATE_MAX_QUBITS);
+	size_t k;
+	for(k = 0; k < count; k++)
+		gate_masks(gates[k], layout->number_of_qubits, layout->bit_of, &masks[k * GATE_MAX_QUBITS]);
+	long chunk;
+	const long chunks = portion_size / cache_size;
+	// циклы внутри ядер вложены в этот и выполняются одним потоком
+	#pragma omp parallel for
+	for(chunk = 0; chunk < chunks; chunk++)
+	{
+		size_t j;
+		for(j = 0; j < count; j++)
+			apply_gate_block(portion + chunk * cache_size * states, cache_size, first_index + chunk * cache_size, gates[j], &masks[j * GATE_MAX_QUBITS], states);
+	}
+}
+
+// Возвращает кубиты на исходные места
+static int restore_layout(complexd *portion, const size_t states, qubit_layout *layout, size_t *sweeps, size_t *exchanges)
+{
+	int bit, code = SUCCESS;
+	for(bit = 0; bit < (int)layout->number_of_qubits && code == SUCCESS; bit++)
+	{
+		int q = layout->number_of_qubits - bit;
+		if(layout->bit_of[q] != bit)
+			code = swap_bits(portion, states, layout, bit, layout->bit_of[q], sweeps, exchanges);
+	}
+	return code;
+}
+
+// Выполнение схемы (portion != NULL) или только подсчет проходов и обменов (portion == NULL).
+// keep_layout: перенесенные в локальные биты кубиты остаются там; иначе глобальный целевой бит
+// на время одного вентиля меняется со старшим свободным локальным и сразу после него возвращается на место.
+// Выполнение начинается с расположения layout; restore - в конце вернуть кубиты на исходные места
+static int run_circuit_dense(complexd *portion, const size_t states, qubit_layout *layout, const gate *gates, const size_t count,
+	const bool keep_layout, const bool restore, std::vector<int> *bits, size_t *sweeps, size_t *exchanges)
+{
+	const size_t number_of_qubits = layout->number_of_qubits;
+	const ulong portion_size = 1UL << layout->local_bits;
+	const ulong first_index = myrank * portion_size;
+	const ulong cache_size = dense_cache_size(portion_size, states);
+	size_t i = 0, k;
+	int code = SUCCESS;
+	while(i < count && code == SUCCESS)
+	{
+		const gate &g = gates[i];
+		if(g.type == GATE_MEASURE)
+		{
+			// вероятности и схлопывание
+			*sweeps += 2;
+			int outcome = 0;
+			if(states > 1)
+			{
+				fprintf(stderr, "%s\n", "Measurement is not supported for a batch of vectors");
+				code = WRONG_VALUE;
+				break;
+			}
+			if(portion != NULL)
+				code = measure_mask(portion, portion_size, 1UL << layout->bit_of[g.qubits[0]], &outcome);
+			if(bits != NULL)
+			{
+				size_t bit = size_t(g.param);
+				if(bits->size() <= bit)
+					bits->resize(bit + 1, 0);
+				(*bits)[bit] = outcome;
+			}
+			i++;
+			continue;
+		}
+		ulong masks[GATE_MAX_QUBITS], busy = 0;
+		gate_masks(g, number_of_qubits, layout->bit_of, masks);
+		for(k = 0; k < g.qubits_num; k++)
+			busy |= masks[k];
+		ulong targets;
+		int swapped[2 * GATE_MAX_QUBITS], swaps = 0;
+		while((targets = layout_target_mask(layout, g)) >= portion_size)
+		{
+			int victim;
+			if(keep_layout)
+				victim = layout_victim(layout, gates + i + 1, count - i - 1, busy);
+			else
+			{
+				victim = layout->local_bits - 1;
+				while(victim >= 0 && (busy & (1UL << victim)))
+					victim--;
+			}
+			if(victim < 0)
+			{
+				fprintf(stderr, "%s\n", "Not enough local qubits for the gate");
+				code = WRONG_VALUE;
+				break;
+			}
+			swapped[2*swaps] = victim;
+			swapped[2*swaps + 1] = log2_of(targets);
+			swaps++;
+			if((code = swap_bits(portion, states, layout, victim, log2_of(targets), sweeps, exchanges)) != SUCCESS)
+				break;
+			busy |= 1UL << victim;
+		}
+		if(code != SUCCESS)
+			break;
+		size_t end = i + 1;
+		if(cache_size < portion_size && targets < cache_size && (keep_layout || swaps == 0))
+			while(end < count && gates[end].type != GATE_MEASURE && layout_target_mask(layout, gates[end]) < cache_size)
+				end++;
+		(*sweeps)++;
+		if(portion != NULL)
+		{
+			if(end - i > 1)
+				apply_group(portion, states, portion_size, cache_size, layout, gates + i, end - i);
+			else
+			{
+				gate_masks(g, number_of_qubits, layout->bit_of, masks);
+				code = apply_gate_block(portion, portion_size, first_index, g, masks, states);
+			}
+		}
+		i = end;
+		while(!keep_layout && swaps > 0 && code == SUCCESS)
+		{
+			swaps--;
+			code = swap_bits(portion, states, layout, swapped[2*swaps], swapped[2*swaps + 1], sweeps, exchanges);
+		}
+	}
+	if(code == SUCCESS && restore)
+		code = restore_layout(portion, states, layout, sweeps, exchanges);
+	return code;
+}
+
+// Какой способ обменов дешевле для схемы: меньше обменов, при равенстве - меньше проходов
+static bool keep_layout_is_cheaper(const gate *gates, const size_t count, const size_t states, const size_t number_of_qubits, const ulong portion_size,
+	size_t *sweeps, size_t *exchanges)
+{
+	size_t keep_sweeps = 0, keep_exchanges = 0, back_sweeps = 0, back_exchanges = 0;
+	qubit_layout layout;
+	layout_init(&layout, number_of_qubits, portion_size);
+	run_circuit_dense(NULL, states, &layout, gates, count, true, true, NULL, &keep_sweeps, &keep_exchanges);
+	layout_init(&layout, number_of_qubits, portion_size);
+	run_circuit_dense(NULL, states, &layout, gates, count, false, true, NULL, &back_sweeps, &back_exchanges);
+	bool keep = keep_exchanges < back_exchanges || (keep_exchanges == back_exchanges && keep_sweeps <= back_sweeps);
+	*sweeps += keep ? keep_sweeps : back_sweeps;
+	*exchanges += keep ? keep_exchanges : back_exchanges;
+	return keep;
+}
+
+int apply_circuit_dense(complexd *portion, const size_t number_of_qubits, const gate *gates, const size_t count, std::vector<int> *bits)
+{
+	const ulong portion_size = (1UL << number_of_qubits) / proc_num;
+	size_t sweeps = 0, exchanges = 0;
+	bool keep_layout = keep_layout_is_cheaper(gates, count, 1, number_of_qubits, portion_size, &sweeps, &exchanges);
+	qubit_layout layout;
+	layout_init(&layout, number_of_qubits, portion_size);
+	int code = run_circuit_dense(portion, 1, &layout, gates, count, keep_layout, true, bits, &sweeps, &exchanges);
+	// ядра вентилей не ведут карту нулевых кусков
+	zero_tracking_refresh(portion);
+	return code;
+}
+
+int apply_circuit_batch(complexd *portion, const size_t states, const size_t number_of_qubits, const gate *gates, const size_t count)
+{
+	const ulong portion_size = (1UL << number_of_qubits) / proc_num;
+	size_t sweeps = 0, exchanges = 0;
+	bool keep_layout = keep_layout_is_cheaper(gates, count, states, number_of_qubits, portion_size, &sweeps, &exchanges);
+	qubit_layout layout;
+	layout_init(&layout, number_of_qubits, portion_size);
+	return run_circuit_dense(portion, states, &layout, gates, count, keep_layout, true, NULL, &sweeps, &exchanges);
+}
+
+int apply_circuit_batch_from(complexd *portion, const size_t states, qubit_layout *layout, const gate *gates, const size_t count)
+{
+	size_t sweeps = 0, exchanges = 0;
+	return run_circuit_dense(portion, states, layout, gates, count, true, false, NULL, &sweeps, &exchanges);
+}
+
+int batch_localize_qubit(complexd *portion, const size_t states, qubit_layout *layout, const size_t qubit, const gate *upcoming, const size_t count)
+{
+	const int bit = layout->bit_of[qubit];
+	if(bit < (int)layout->local_bits)
+		return SUCCESS;
+	const int victim = layout_victim(layout, upcoming, count, 0);
+	if(victim < 0) {
+		fprintf(stderr, "%s\n", "Not enough local qubits for the gate");
+		return WRONG_VALUE;
+	}
+	size_t sweeps = 0, exchanges = 0;
+	return swap_bits(portion, states, layout, victim, bit, &sweeps, &exchanges);
+}
+
+int batch_restore_layout(complexd *portion, const size_t states, qubit_layout *layout)
+{
+	size_t sweeps = 0, exchanges = 0;
+	return restore_layout(portion, states, layout, &sweeps, &exchanges);
+}
+
+void dense_circuit_cost(const gate *gates, const size_t count, const size_t number_of_qubits, const int processes, size_t *sweeps, size_t *exchanges)
+{
+	keep_layout_is_cheaper(gates, count, 1, number_of_qubits, (1UL << number_of_qubits) / processes, sweeps, exchanges);
+}
+
+void qft_circuit(const size_t number_of_qubits, std::vector<gate> &gates)
+{
+	// как в qft_transform: для n = 1..N сначала R_{pi/2^{n-i}} на (n, i), затем адамар на n
+	size_t n, i;
+	for(n = 1; n <= number_of_qubits; n++)
+	{
+		for(i = 1; i <= n-1; i++)
+			gates.push_back(make_gate2(GATE_CP, n, i, pi/(1UL << (n-i))));
+		gates.push_back(make_gate1(GATE_H, n));
+	}
+}
@@ -1,11 +1,21 @@
 #include "functions.h"
+#include "manifest.h"
+#include "batch.h"
 #include <stdlib.h>
+#include <cstring>
 
 int myrank, proc_num, i_am_the_master;
 
 void usage()
 {
 	printf("Usage: generate <output_file> <number_of_qubits>\n");
+	printf("       generate --manifest <file>    lines \"<output_file> <number_of_qubits>\"\n");
+}
+
+int generate_job(const manifest_job &job, complexd **vectors, void *)
+{
+	generate_state(vectors[0], job.number_of_qubits);
+	return batch_write_vectors(vectors[0], job.number_of_qubits, job.files);
 }
 
 int main(int argc, char **argv)
@@ -18,6 +28,13 @@ int main(int argc, char **argv)
 		if(i_am_the_master) 
 			usage();
 	}
+	else if(strcmp(argv[1], "--manifest") == 0) {
+		functions_init(myrank, proc_num, i_am_the_master);
+		std::vector<manifest_job> jobs;
+		if(read_manifest(argv[2], 1, jobs) == SUCCESS)
+			manifest_run(jobs, 0, 1, generate_job, NULL);
+		functions_clean();
+	}
 	else {
 		// инициализация библиотеки
 	    functions_init(myrank, proc_num, i_am_the_master);
@@ -0,0 +1,101 @@
+#include "grover.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Помеченные индексы этой части: [first, last) в oracle->marked
+static void local_marked(const grover_oracle *oracle, const ulong begin, const ulong end, size_t *first, size_t *last)
+{
+	const std::vector<ulong> &marked = oracle->marked;
+	*first = std::lower_bound(marked.begin(), marked.end(), begin) - marked.begin();
+	*last = std::lower_bound(marked.begin(), marked.end(), end) - marked.begin();
+}
+
+// Первый проход: оракул и сумма амплитуд после него
+static complexd oracle_and_sum(complexd *portion, const ulong portion_size, const grover_oracle *oracle)
+{
+	const ulong begin = myrank * portion_size;
+	double re = 0, im = 0;
+	long i;
+	const long size = portion_size;
+	if(oracle->predicate != NULL)
+	{
+		#pragma omp parallel for reduction(+:re,im)
+		for(i = 0; i < size; i++)
+		{
+			if(oracle->predicate(begin + i, oracle->arg))
+				portion[i] = -portion[i];
+			re += portion[i].real();
+			im += portion[i].imag();
+		}
+	}
+	else
+	{
+		// список короткий: знаки меняются отдельно, сумма - обычный проход
+		size_t first, last, k;
+		local_marked(oracle, begin, begin + portion_size, &first, &last);
+		for(k = first; k < last; k++)
+			portion[oracle->marked[k] - begin] = -portion[oracle->marked[k] - begin];
+		#pragma omp parallel for reduction(+:re,im)
+		for(i = 0; i < size; i++)
+		{
+			re += portion[i].real();
+			im += portion[i].imag();
+		}
+	}
+	return complexd(re, im);
+}
+
+int grover_iterate(complexd *portion, const size_t number_of_qubits, const grover_oracle *oracle, const size_t iterations)
+{
+	const ulong portion_size = (1UL << number_of_qubits) / proc_num;
+	const double dimension = double(1UL << number_of_qubits);
+	long i;
+	const long size = portion_size;
+	size_t step;
+	for(step = 0; step < iterations; step++)
+	{
+		complexd sum = oracle_and_sum(portion, portion_size, oracle);
+		MPI_Allreduce(MPI_IN_PLACE, &sum, 1, MPI_DOUBLE_COMPLEX, MPI_SUM, MPI_COMM_WORLD);
+		// второй проход: отражение относительно среднего
+		const complexd twice_mean = 2.0 * sum / dimension;
+		#pragma omp parallel for
+		for(i = 0; i < size; i++)
+			portion[i] = twice_mean - portion[i];
+	}
+	return SUCCESS;
+}
+
+double grover_marked_probability(const complexd *portion, const size_t number_of_qubits, const grover_oracle *oracle)
+{
+	const ulong portion_size = (1UL << number_of_qubits) / proc_num;
+	const ulong begin = myrank * portion_size;
+	double probability = 0;
+	if(oracle->predicate != NULL)
+	{
+		long i;
+		const long size = portion_size;
+		#pragma omp parallel for reduction(+:probability)
+		for(i = 0; i < size; i++)
+			if(oracle->predicate(begin + i, oracle->arg))
+				probability += std::norm(portion[i]);
+	}
+	else
+	{
+		size_t first, last, k;
+		local_marked(oracle, begin, begin + portion_size, &first, &last);
+		for(k = first; k < last; k++)
+			probability += std::norm(portion[oracle->marked[k] - begin]);
+	}
+	MPI_Allreduce(MPI_IN_PLACE, &probability, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+	return probability;
+}
+
+size_t grover_optimal_iterations(const size_t number_of_qubits, const ulong marked)
+{
+	if(marked == 0)
+		return 0;
+	const double theta = asin(sqrt(double(marked) / double(1UL << number_of_qubits)));
+	const double best = M_PI / (4 * theta) - 0.5;
+	return best > 0 ? size_t(floor(best + 0.5)) : 0;
+}
@@ -1,7 +1,33 @@
 #include "functions.h"
+#include "ooc.h"
+#include "compress.h"
+#include "sparse.h"
+#include "circuit.h"
+#include "optimize.h"
+#include "schedule.h"
+#include "estimate.h"
+#include "batch.h"
+#include "manifest.h"
+#include "serve.h"
+#include "shm.h"
+#include "observe.h"
+#include "noise.h"
+#include "density.h"
+#include "grover.h"
+#include "qaoa.h"
+#include "trotter.h"
+#include "adjoint.h"
+#include "checkpoint.h"
+#include "permutation.h"
+#include "semiclassical.h"
+#include "stabilizer.h"
 
+#include <algorithm>
 #include <cassert>
+#include <fcntl.h>
+#include <unistd.h>
 #include <string>
+#include <cstring>
 #include <stdlib.h>
 
 int myrank, proc_num, i_am_the_master;
@@ -15,10 +41,13 @@ int test_qft(const char *input_file, const char *_output_file, const size_t numb
 	// выделяем память под вектор
 	complexd *portion = NULL;
 	mymalloc(&portion, number_of_qubits);
+	// нулевые куски (например, у базисного состояния) не будут обрабатываться
+	zero_tracking_attach(portion, number_of_qubits);
 	// читаем из входного файла
 	read_vector_from_file(portion, number_of_qubits, input_file);
 	// делаем копию вектора
 	complexd *portion_copy = copy_state(portion, number_of_qubits);
+	zero_tracking_attach(portion_copy, number_of_qubits);
 	// преобразовываем
 	qft_transform(portion, number_of_qubits);
 	qft_transform_by_transposition(portion_copy, number_of_qubits);
@@ -30,8 +59,1144 @@ int test_qft(const char *input_file, const char *_output_file, const size_t numb
 	return SUCCESS;
 }
 
+// Что делает запуск solve. Выбирается один раз в parse_options: точкой входа (--manifest, --serve)
+// или ключом режима; два ключа режима в одной командной строке - ошибка
+enum solve_mode
+{
+	SOLVE_QFT,				// без ключей режима
+	SOLVE_CIRCUIT,			// только --circuit
+	SOLVE_MANIFEST,			// solve --manifest <manifest_file>
+	SOLVE_SERVE,			// solve --serve <socket_path> <number_of_qubits>
+	SOLVE_OUT_OF_CORE,
+	SOLVE_COMPRESSED,
+	SOLVE_SPARSE,
+	SOLVE_BATCH,
+	SOLVE_ESTIMATE,
+	SOLVE_CALIBRATE,
+	SOLVE_SHARED,
+	SOLVE_AMPLITUDES,
+	SOLVE_NOISE,
+	SOLVE_DENSITY,
+	SOLVE_GROVER,
+	SOLVE_QAOA,
+	SOLVE_TROTTER,
+	SOLVE_GRADIENT,
+	SOLVE_ORACLE,
+	SOLVE_SEMICLASSICAL
+};
+
+// Параметры solve после трех обязательных
+struct solve_options
+{
+	solve_mode mode;
+	const char *circuit_file;	// --circuit: схема из файла вместо QFT
+	bool no_optimize;			// --no-optimize: выполнять схему из файла как есть, без упрощения и переупорядочивания
+	const char *ooc_prefix;		// --out-of-core
+	bool compressed;			// --compressed
+	bool sparse;				// --sparse
+	size_t memory_mb;
+	double error_bound;
+	double density;
+	bool basis;					// --basis: вход --sparse - базисное состояние, файл не читается (для 40-60 кубитов)
+	ulong basis_index;
+	int estimate_processes;		// --estimate: только оценка выполнения на стольких процессах
+	int estimate_threads;
+	const char *costs_file;		// --costs: стоимости ядер из --calibrate
+	const char *calibrate_file;	// --calibrate: измерить стоимости ядер и записать в файл
+	const char *batch_file;		// --batch: пары входной и выходной файл, обрабатываемые пачками
+	size_t batch_states;
+	const char *shm_name;		// --shm: итоговый вектор остается в разделяемой памяти вместо выходного файла
+	const char *amplitudes;		// --amplitudes: только эти амплитуды выхода QFT, без преобразования вектора
+	size_t trajectories;		// --trajectories: столько траекторий с шумом --noise, по trajectory_states за проход
+	size_t trajectory_states;
+	noise_model noise;
+	size_t noise_from;			// --noise-from: вентили до этого номера выполняются без шума, один раз для всех траекторий
+	const char *grover_oracle;	// --grover: помеченные индексы через запятую или маска:значение
+	size_t grover_iterations;	// 0 - оптимальное число шагов
+	const char *qaoa_graph;		// --qaoa: граф MaxCut и углы gamma1,beta1,gamma2,beta2,...
+	const char *qaoa_angles;
+	const char *hamiltonian_file;	// --trotter: эволюция exp(-iHt) шагами Троттера
+	double evolution_time;
+	size_t trotter_steps;
+	int trotter_order;
+	const char *observables;	// --observe: строки Паули через запятую, каждые observe_every шагов
+	size_t observe_every;
+	const char *gradient_hamiltonian;	// --gradient: <H> и производные по углам вентилей схемы
+	const char *oracle;			// --oracle: перестановка базисных состояний modexp:a:N:x_qubits или add:k
+	size_t semiclassical_shots;	// --semiclassical: столько измерений выхода QFT полуклассической схемой
+	bool seeded;				// --seed: зерно генератора исходов измерений
+	ulong seed;
+	size_t checkpoint_mb;		// --checkpoints: кэш промежуточных состояний заданий манифеста
+	const char *spill_prefix;	// --spill: вытесненные из кэша состояния на локальном диске
+	size_t spill_mb;
+	const char *density_reference;	// --density: матрица плотности с шумом --noise, точность относительно этого чистого состояния
+};
+
+void print_optimize_report(const optimize_report *report)
+{
+	if(i_am_the_master)
+		printf("Optimized: %zu -> %zu gates, %zu -> %zu sweeps, %zu -> %zu exchanges\n", report->before.gates, report->after.gates,
+			report->before.sweeps, report->after.sweeps, report->before.exchanges, report->after.exchanges);
+}
+
+void print_schedule_report(const optimize_report *report)
+{
+	if(i_am_the_master)
+		printf("Scheduled: %zu -> %zu exchanges, %zu -> %zu sweeps\n", report->before.exchanges, report->after.exchanges,
+			report->before.sweeps, report->after.sweeps);
+}
+
+void print_bits(const std::vector<int> &bits)
+{
+	if(!i_am_the_master || bits.empty())
+		return;
+	std::string line;
+	size_t k;
+	for(k = 0; k < bits.size(); k++)
+		line += bits[k] ? '1' : '0';
+	printf("Measured: c = %s\n", line.c_str());
+}
+
+// Вентили схемы из файла или QFT, если файл не задан
+int load_gates(const solve_options *options, const size_t number_of_qubits, std::vector<gate> &gates)
+{
+	if(options->circuit_file == NULL) {
+		qft_circuit(number_of_qubits, gates);
+		return SUCCESS;
+	}
+	int code = read_circuit(options->circuit_file, number_of_qubits, gates);
+	if(code == SUCCESS && !options->no_optimize) {
+		optimize_report report;
+		optimize_report_init(&report);
+		optimize_circuit(gates, number_of_qubits, &report);
+		print_optimize_report(&report);
+		optimize_report_init(&report);
+		schedule_circuit(gates, number_of_qubits, proc_num, &report);
+		print_schedule_report(&report);
+	}
+	return code;
+}
+
+// Шум добавляется после каждого вентиля схемы как она записана, поэтому оптимизатор ее не меняет:
+// сокращение и перестановка вентилей (последняя зависит от числа процессов) изменили бы модель шума
+int load_noisy_gates(const solve_options *options, const size_t number_of_qubits, std::vector<gate> &gates)
+{
+	const noise_model &noise = options->noise;
+	solve_options as_written = *options;
+	as_written.no_optimize = options->no_optimize || noise.rotation > 0 || noise.depolarizing > 0 || noise.damping > 0;
+	return load_gates(&as_written, number_of_qubits, gates);
+}
+
+// Схема из файла над обычным распределенным вектором: пачки вентилей выполняются по мере разбора
+int run_circuit(const char *input_file, const char *output_file, const size_t number_of_qubits, const char *circuit_file, const bool optimize)
+{
+	complexd *portion = NULL;
+	int code = mymalloc(&portion, number_of_qubits);
+	if(code != SUCCESS)
+		return code;
+	read_vector_from_file(portion, number_of_qubits, input_file);
+	circuit_parser parser;
+	code = circuit_open(&parser, circuit_file, number_of_qubits);
+	std::vector<gate> batch;
+	std::vector<int> bits;
+	size_t gates_num = 0;
+	// пачки оптимизируются и переупорядочиваются по отдельности
+	optimize_report report, schedule_report;
+	optimize_report_init(&report);
+	optimize_report_init(&schedule_report);
+	// клиффордово начало схемы над базисным входом идет по таблице стабилизаторов, вектор пишется из нее
+	// перед первым неклиффордовым вентилем
+	stabilizer_state stabilizer;
+	bool tableau = false, first_batch = true;
+	size_t clifford_num = 0;
+	while(code == SUCCESS)
+	{
+		code = circuit_next_batch(&parser, batch);
+		if(code != SUCCESS || batch.empty())
+			break;
+		gates_num += batch.size();
+		if(optimize) {
+			optimize_circuit(batch, number_of_qubits, &report);
+			schedule_circuit(batch, number_of_qubits, proc_num, &schedule_report);
+		}
+		// оптимизатор может сократить пачку целиком
+		if(batch.empty())
+			continue;
+		if(first_batch && is_clifford(batch[0]))
+			code = stabilizer_from_vector(&stabilizer, portion, number_of_qubits, &tableau);
+		first_batch = false;
+		size_t applied = 0;
+		if(tableau)
+		{
+			stabilizer_apply_circuit(&stabilizer, batch.data(), batch.size(), &applied);
+			clifford_num += applied;
+			if(applied < batch.size()) {
+				stabilizer_to_dense(&stabilizer, portion);
+				tableau = false;
+			}
+		}
+		if(code == SUCCESS && applied < batch.size())
+			code = apply_circuit_dense(portion, number_of_qubits, batch.data() + applied, batch.size() - applied, &bits);
+	}
+	circuit_close(&parser);
+	if(code == SUCCESS && tableau)
+		stabilizer_to_dense(&stabilizer, portion);
+	if(code == SUCCESS)
+	{
+		if(i_am_the_master) {
+			printf("Circuit: %zu gates\n", gates_num);
+			if(clifford_num > 0)
+				printf("Stabilizer tableau: first %zu Clifford gates\n", clifford_num);
+		}
+		if(optimize) {
+			print_optimize_report(&report);
+			print_schedule_report(&schedule_report);
+		}
+		print_bits(bits);
+		code = write_vector_to_file(portion, number_of_qubits, output_file);
+	}
+	myfree(portion);
+	return code;
+}
+
+// Состояние solve --manifest между заданиями: вентили строятся заново, лишь когда меняется число кубитов или схема
+struct manifest_state
+{
+	const solve_options *options;
+	size_t number_of_qubits;
+	std::string circuit_file;	// схема, из которой получены gates
+	std::vector<gate> gates;
+	checkpoint_cache *cache;	// NULL - без кэша
+};
+
+int solve_job(const manifest_job &job, complexd **vectors, void *arg)
+{
+	manifest_state *state = (manifest_state *)arg;
+	int code = SUCCESS;
+	// схема задания - третий файл строки, если он есть
+	const std::string circuit_file = job.files.size() > 2 ? job.files[2]
+		: (state->options->circuit_file != NULL ? state->options->circuit_file : "");
+	if(state->number_of_qubits != job.number_of_qubits || state->circuit_file != circuit_file)
+	{
+		solve_options options = *state->options;
+		options.circuit_file = circuit_file.empty() ? NULL : circuit_file.c_str();
+		state->gates.clear();
+		state->number_of_qubits = job.number_of_qubits;
+		state->circuit_file = circuit_file;
+		code = load_gates(&options, job.number_of_qubits, state->gates);
+	}
+	std::vector<int> bits;
+	if(code == SUCCESS && state->cache != NULL)
+		code = checkpoint_apply_circuit(state->cache, vectors[0], job.number_of_qubits, state->gates.data(), state->gates.size(), &bits);
+	else if(code == SUCCESS)
+		code = apply_circuit_dense(vectors[0], job.number_of_qubits, state->gates.data(), state->gates.size(), &bits);
+	if(code == SUCCESS)
+	{
+		print_bits(bits);
+		std::vector<std::string> output(1, job.files[1]);
+		code = batch_write_vectors(vectors[0], job.number_of_qubits, output);
+	}
+	if(code != SUCCESS)
+		// при ошибке схема будет разобрана заново
+		state->number_of_qubits = 0;
+	return code;
+}
+
+// Все задания манифеста "<входной файл> <выходной файл> [<схема>] <number_of_qubits>" в одном запуске
+int run_manifest(const solve_options *options, const char *manifest_file)
+{
+	std::vector<manifest_job> jobs;
+	int code = read_manifest(manifest_file, 2, jobs, 1);
+	if(code != SUCCESS)
+		return code;
+	manifest_state state;
+	state.options = options;
+	state.number_of_qubits = 0;
+	checkpoint_cache cache;
+	state.cache = NULL;
+	if(options->checkpoint_mb > 0) {
+		checkpoint_cache_init(&cache, options->checkpoint_mb, options->spill_prefix, options->spill_mb);
+		state.cache = &cache;
+	}
+	code = manifest_run(jobs, 1, 1, solve_job, &state);
+	if(code == SUCCESS && i_am_the_master)
+		printf("Manifest: %zu jobs\n", jobs.size());
+	if(state.cache != NULL)
+	{
+		if(i_am_the_master)
+			printf("Checkpoints: %zu hits in %zu runs, %zu of %zu gates skipped, %zu states spilled to disk\n", cache.hits, cache.runs,
+				cache.gates_skipped, cache.gates_total, cache.spilled);
+		checkpoint_cache_free(&cache);
+	}
+	return code;
+}
+
+// Вектор считается прямо в разделяемой памяти и остается там для view и fidelity
+int run_shared(const char *input_file, const size_t number_of_qubits, const solve_options *options)
+{
+	shm_portion mapping;
+	int code = shm_create(options->shm_name, number_of_qubits, &mapping);
+	if(code != SUCCESS)
+		return code;
+	std::vector<gate> gates;
+	std::vector<int> bits;
+	code = read_vector_from_file(mapping.portion, number_of_qubits, input_file);
+	if(code == SUCCESS)
+		code = load_gates(options, number_of_qubits, gates);
+	if(code == SUCCESS)
+		code = apply_circuit_dense(mapping.portion, number_of_qubits, gates.data(), gates.size(), &bits);
+	if(code != SUCCESS) {
+		shm_detach(&mapping);
+		return code;
+	}
+	print_bits(bits);
+	code = shm_publish(options->shm_name, &mapping);
+	if(code == SUCCESS && i_am_the_master)
+		printf("Shared: %zu qubits in shared memory %s\n", number_of_qubits, options->shm_name);
+	return code;
+}
+
+// Индексы через запятую
+bool parse_index_list(const char *list, std::vector<ulong> &indices)
+{
+	const char *p = list;
+	char *end = NULL;
+	do
+	{
+		indices.push_back(strtoul(p, &end, 10));
+		if(end == p || (*end != ',' && *end != '\0'))
+			return false;
+		p = end + 1;
+	} while(*end == ',');
+	return true;
+}
+
+// Выбранные амплитуды выхода QFT по входному вектору. Если задан выходной файл (не "-"),
+// они сверяются с лежащими в нем
+int run_amplitudes(const char *input_file, const char *output_file, const size_t number_of_qubits, const char *list)
+{
+	std::vector<ulong> indices;
+	if(!parse_index_list(list, indices)) {
+		if(i_am_the_master)
+			fprintf(stderr, "Wrong list of amplitudes %s\n", list);
+		return WRONG_VALUE;
+	}
+	complexd *portion = NULL;
+	int code = mymalloc(&portion, number_of_qubits);
+	if(code != SUCCESS)
+		return code;
+	std::vector<complexd> amplitudes;
+	code = batch_read_vectors(portion, number_of_qubits, std::vector<std::string>(1, input_file));
+	if(code == SUCCESS)
+		code = qft_amplitudes(portion, number_of_qubits, indices, amplitudes);
+	myfree(portion);
+	if(code != SUCCESS || !i_am_the_master)
+		return code;
+	size_t k;
+	for(k = 0; k < indices.size(); k++)
+		printf("amplitude[%lu] = (%.15g, %.15g)\n", indices[k], amplitudes[k].real(), amplitudes[k].imag());
+	if(strcmp(output_file, "-") != 0)
+	{
+		int fd = open(output_file, O_RDONLY);
+		double deviation = 0;
+		for(k = 0; k < indices.size() && fd >= 0 && code == SUCCESS; k++)
+		{
+			complexd stored;
+			code = full_pread(fd, &stored, sizeof(stored), indices[k] * sizeof(complexd));
+			deviation = std::max(deviation, std::abs(stored - amplitudes[k]));
+		}
+		if(fd < 0 || code != SUCCESS)
+			fprintf(stderr, "Cannot read amplitudes from %s\n", output_file);
+		else
+			printf("Max deviation from %s: %.3e\n", output_file, deviation);
+		if(fd >= 0)
+			close(fd);
+	}
+	return code;
+}
+
+// Траектории Монте-Карло с шумом: точность относительно схемы без шума копится по мере выполнения
+int run_noise(const char *input_file, const size_t number_of_qubits, const solve_options *options)
+{
+	std::vector<gate> gates;
+	int code = load_noisy_gates(options, number_of_qubits, gates);
+	if(code != SUCCESS)
+		return code;
+	const size_t prefix = std::min(options->noise_from, gates.size());
+	complexd *start = NULL, *ideal = NULL;
+	if((code = mymalloc(&start, number_of_qubits)) != SUCCESS)
+		return code;
+	code = batch_read_vectors(start, number_of_qubits, std::vector<std::string>(1, input_file));
+	// общий префикс без шума считается один раз, его результат - начало каждой траектории
+	if(code == SUCCESS)
+		code = apply_circuit_dense(start, number_of_qubits, gates.data(), prefix);
+	if(code == SUCCESS)
+	{
+		ideal = copy_state(start, number_of_qubits);
+		code = apply_circuit_dense(ideal, number_of_qubits, gates.data() + prefix, gates.size() - prefix);
+	}
+	noise_statistics stats;
+	noise_statistics_init(&stats);
+	while(code == SUCCESS && stats.trajectories < options->trajectories)
+	{
+		const size_t states = std::min(options->trajectory_states, options->trajectories - stats.trajectories);
+		code = run_trajectories(start, ideal, number_of_qubits, gates.data() + prefix, gates.size() - prefix, &options->noise, states, &stats);
+		if(code == SUCCESS && i_am_the_master)
+			printf("Trajectories %zu: fidelity %.6lf +- %.6lf (std %.6lf, min %.6lf)\n", stats.trajectories, stats.mean,
+				noise_statistics_std(&stats) / sqrt(double(stats.trajectories)), noise_statistics_std(&stats), stats.min);
+	}
+	if(ideal != NULL)
+		myfree(ideal);
+	myfree(start);
+	return code;
+}
+
+// Помечены индексы с (index & mask) == value
+struct mask_predicate
+{
+	ulong mask;
+	ulong value;
+};
+
+static bool mask_matches(const ulong index, void *arg)
+{
+	const mask_predicate *predicate = (const mask_predicate *)arg;
+	return (index & predicate->mask) == predicate->value;
+}
+
+// Шаги Гровера над входным вектором; выходной файл (если не "-") - вектор после них
+int run_grover(const char *input_file, const char *output_file, const size_t number_of_qubits, const char *oracle_text, size_t iterations)
+{
+	const ulong dimension = 1UL << number_of_qubits;
+	grover_oracle oracle;
+	oracle.predicate = NULL;
+	oracle.arg = NULL;
+	mask_predicate masked;
+	ulong marked_num = 0;
+	char *end = NULL;
+	bool parsed;
+	if(strchr(oracle_text, ':') != NULL)
+	{
+		masked.mask = strtoul(oracle_text, &end, 0);
+		parsed = *end == ':';
+		masked.value = parsed ? strtoul(end + 1, &end, 0) : 0;
+		parsed = parsed && *end == '\0' && (masked.value & ~masked.mask) == 0 && masked.mask < dimension;
+		oracle.predicate = mask_matches;
+		oracle.arg = &masked;
+		marked_num = dimension >> __builtin_popcountl(masked.mask);
+	}
+	else
+	{
+		parsed = parse_index_list(oracle_text, oracle.marked);
+		std::sort(oracle.marked.begin(), oracle.marked.end());
+		oracle.marked.erase(std::unique(oracle.marked.begin(), oracle.marked.end()), oracle.marked.end());
+		parsed = parsed && oracle.marked.back() < dimension;
+		marked_num = oracle.marked.size();
+	}
+	if(!parsed) {
+		if(i_am_the_master)
+			fprintf(stderr, "Wrong Grover oracle %s\n", oracle_text);
+		return WRONG_VALUE;
+	}
+	if(iterations == 0)
+		iterations = grover_optimal_iterations(number_of_qubits, marked_num);
+	complexd *portion = NULL;
+	int code = mymalloc(&portion, number_of_qubits);
+	if(code != SUCCESS)
+		return code;
+	code = batch_read_vectors(portion, number_of_qubits, std::vector<std::string>(1, input_file));
+	double start = MPI_Wtime();
+	if(code == SUCCESS)
+		code = grover_iterate(portion, number_of_qubits, &oracle, iterations);
+	if(code == SUCCESS)
+	{
+		const double time = MPI_Wtime() - start;
+		const double probability = grover_marked_probability(portion, number_of_qubits, &oracle);
+		if(i_am_the_master)
+			printf("Grover: %lu marked, %zu iterations in %.3lf s, marked probability %.12lf\n", marked_num, iterations, time, probability);
+	}
+	if(code == SUCCESS && strcmp(output_file, "-") != 0)
+		code = batch_write_vectors(portion, number_of_qubits, std::vector<std::string>(1, output_file));
+	myfree(portion);
+	return code;
+}
+
+// QAOA для MaxCut; входной файл "-" - равномерная суперпозиция |+>^n
+int run_qaoa(const char *input_file, const char *output_file, const size_t number_of_qubits, const char *graph_file, const char *angles)
+{
+	std::vector<double> gammas, betas;
+	const char *p = angles;
+	char *end = NULL;
+	do
+	{
+		const double angle = strtod(p, &end);
+		if(end == p || (*end != ',' && *end != '\0')) {
+			gammas.clear();
+			break;
+		}
+		(gammas.size() == betas.size() ? gammas : betas).push_back(angle);
+		p = end + 1;
+	} while(*end == ',');
+	if(gammas.empty() || gammas.size() != betas.size()) {
+		if(i_am_the_master)
+			fprintf(stderr, "Wrong QAOA angles %s, expected gamma1,beta1,gamma2,beta2,...\n", angles);
+		return WRONG_VALUE;
+	}
+	qaoa_graph graph;
+	int code = read_graph(graph_file, number_of_qubits, &graph);
+	if(code != SUCCESS)
+		return code;
+	complexd *portion = NULL;
+	if((code = mymalloc(&portion, number_of_qubits)) != SUCCESS)
+		return code;
+	if(strcmp(input_file, "-") == 0)
+	{
+		const ulong portion_size = (1UL << number_of_qubits) / proc_num;
+		std::fill(portion, portion + portion_size, complexd(1 / sqrt(double(1UL << number_of_qubits))));
+	}
+	else
+		code = batch_read_vectors(portion, number_of_qubits, std::vector<std::string>(1, input_file));
+	qaoa_result result;
+	double start = MPI_Wtime();
+	if(code == SUCCESS)
+		code = qaoa_run(portion, number_of_qubits, &graph, gammas, betas, &result);
+	if(code == SUCCESS && i_am_the_master)
+		printf("QAOA: %zu edges, %zu layers in %.3lf s, <C> = %.12lf, max cut %g with probability %.12lf\n", graph.edges.size(),
+			gammas.size(), MPI_Wtime() - start, result.expectation, result.max_cut, result.max_cut_probability);
+	if(code == SUCCESS && strcmp(output_file, "-") != 0)
+		code = batch_write_vectors(portion, number_of_qubits, std::vector<std::string>(1, output_file));
+	myfree(portion);
+	return code;
+}
+
+// Эволюция во времени; выходной файл (если не "-") - вектор в конце
+int run_trotter(const char *input_file, const char *output_file, const size_t number_of_qubits, const solve_options *options)
+{
+	std::vector<pauli_term> terms;
+	int code = read_hamiltonian(options->hamiltonian_file, number_of_qubits, terms);
+	if(code != SUCCESS)
+		return code;
+	trotter_options evolution;
+	evolution.time = options->evolution_time;
+	evolution.steps = options->trotter_steps;
+	evolution.order = options->trotter_order;
+	evolution.observe_every = options->observe_every;
+	if(options->observables != NULL)
+	{
+		std::string list(options->observables);
+		size_t start = 0, comma;
+		do
+		{
+			comma = list.find(',', start);
+			evolution.observables.push_back(list.substr(start, comma - start));
+			start = comma + 1;
+		} while(comma != std::string::npos);
+	}
+	complexd *portion = NULL;
+	if((code = mymalloc(&portion, number_of_qubits)) != SUCCESS)
+		return code;
+	code = batch_read_vectors(portion, number_of_qubits, std::vector<std::string>(1, input_file));
+	std::vector<trotter_sample> samples;
+	double start = MPI_Wtime();
+	if(code == SUCCESS)
+		code = trotter_evolve(portion, number_of_qubits, terms, &evolution, samples);
+	if(code == SUCCESS && i_am_the_master)
+	{
+		printf("Trotter: %zu terms, %zu steps of order %d in %.3lf s\n", terms.size(), evolution.steps, evolution.order, MPI_Wtime() - start);
+		size_t s, k;
+		for(s = 0; s < samples.size() && !evolution.observables.empty(); s++)
+		{
+			printf("t = %.6lf (step %zu):", samples[s].time, samples[s].step);
+			for(k = 0; k < samples[s].values.size(); k++)
+				printf(" <%s> = %.12lf", evolution.observables[k].c_str(), samples[s].values[k]);
+			printf("\n");
+		}
+	}
+	if(code == SUCCESS && strcmp(output_file, "-") != 0)
+		code = batch_write_vectors(portion, number_of_qubits, std::vector<std::string>(1, output_file));
+	myfree(portion);
+	return code;
+}
+
+// Градиенты <H> по углам RX, RZ и CP схемы как она записана (оптимизатор складывает углы)
+int run_gradient(const char *input_file, const size_t number_of_qubits, const solve_options *options)
+{
+	std::vector<pauli_term> terms;
+	int code = read_hamiltonian(options->gradient_hamiltonian, number_of_qubits, terms);
+	if(code != SUCCESS)
+		return code;
+	std::vector<gate> gates;
+	solve_options as_written = *options;
+	as_written.no_optimize = true;
+	if((code = load_gates(&as_written, number_of_qubits, gates)) != SUCCESS)
+		return code;
+	complexd *psi = NULL, *lambda = NULL;
+	if((code = mymalloc(&psi, number_of_qubits)) != SUCCESS)
+		return code;
+	if((code = mymalloc(&lambda, number_of_qubits)) != SUCCESS) {
+		myfree(psi);
+		return code;
+	}
+	code = batch_read_vectors(psi, number_of_qubits, std::vector<std::string>(1, input_file));
+	double energy = 0, start = MPI_Wtime();
+	std::vector<double> gradients;
+	if(code == SUCCESS)
+		code = adjoint_gradients(psi, lambda, number_of_qubits, gates.data(), gates.size(), terms, &energy, gradients);
+	if(code == SUCCESS && i_am_the_master)
+	{
+		printf("Gradient: %zu parameters of %zu gates in %.3lf s, <H> = %.12lf\n", gradients.size(), gates.size(), MPI_Wtime() - start, energy);
+		size_t g, k = 0, q;
+		for(g = 0; g < gates.size(); g++)
+			if(gate_has_parameter(gates[g]))
+			{
+				printf("gate %zu %s(%.12g)", g, gate_name(gates[g].type), gates[g].param);
+				for(q = 0; q < gates[g].qubits_num; q++)
+					printf("%s%u", q == 0 ? " " : ",", gates[g].qubits[q]);
+				printf(": %.12lf\n", gradients[k++]);
+			}
+	}
+	myfree(lambda);
+	myfree(psi);
+	return code;
+}
+
+// Классический оракул над входным вектором; выходной файл (если не "-") - вектор после него
+int run_oracle(const char *input_file, const char *output_file, const size_t number_of_qubits, const char *oracle_text)
+{
+	modexp_oracle modexp;
+	ulong shift_and_mask[2] = { 0, (1UL << number_of_qubits) - 1 };
+	permutation_function f = NULL;
+	void *arg = NULL;
+	unsigned long a, modulus, x_qubits, shift;
+	char tail;
+	int code = WRONG_VALUE;
+	if(sscanf(oracle_text, "modexp:%lu:%lu:%lu%c", &a, &modulus, &x_qubits, &tail) == 3) {
+		code = modexp_oracle_init(&modexp, number_of_qubits, a, modulus, x_qubits);
+		f = modexp_permutation;
+		arg = &modexp;
+	}
+	else if(sscanf(oracle_text, "add:%lu%c", &shift, &tail) == 1) {
+		shift_and_mask[0] = shift & shift_and_mask[1];
+		f = add_permutation;
+		arg = shift_and_mask;
+		code = SUCCESS;
+	}
+	else if(i_am_the_master)
+		fprintf(stderr, "Wrong oracle %s, expected modexp:<a>:<N>:<x_qubits> or add:<k>\n", oracle_text);
+	if(code != SUCCESS)
+		return code;
+	complexd *portion = NULL;
+	if((code = mymalloc(&portion, number_of_qubits)) != SUCCESS)
+		return code;
+	code = batch_read_vectors(portion, number_of_qubits, std::vector<std::string>(1, input_file));
+	double start = MPI_Wtime();
+	if(code == SUCCESS)
+		code = apply_permutation(portion, number_of_qubits, f, arg);
+	if(code == SUCCESS && i_am_the_master)
+		printf("Oracle %s: %.3lf s\n", oracle_text, MPI_Wtime() - start);
+	if(code == SUCCESS && strcmp(output_file, "-") != 0)
+		code = batch_write_vectors(portion, number_of_qubits, std::vector<std::string>(1, output_file));
+	myfree(portion);
+	return code;
+}
+
+// Полуклассическое QFT с измерением: каждый выстрел заново читает вход. Выходной файл (если не "-") -
+// состояние после последнего измерения
+int run_semiclassical(const char *input_file, const char *output_file, const size_t number_of_qubits, const size_t shots)
+{
+	complexd *portion = NULL;
+	int code = mymalloc(&portion, number_of_qubits);
+	if(code != SUCCESS)
+		return code;
+	double time = 0;
+	size_t shot;
+	for(shot = 0; shot < shots && code == SUCCESS; shot++)
+	{
+		code = batch_read_vectors(portion, number_of_qubits, std::vector<std::string>(1, input_file));
+		MPI_Barrier(MPI_COMM_WORLD);
+		double start = MPI_Wtime();
+		ulong outcome;
+		double probability;
+		if(code == SUCCESS)
+			code = semiclassical_qft(portion, number_of_qubits, &outcome, &probability);
+		time += MPI_Wtime() - start;
+		if(code == SUCCESS && i_am_the_master)
+			printf("Shot %zu: outcome %lu, probability %.6e\n", shot + 1, outcome, probability);
+	}
+	if(code == SUCCESS && i_am_the_master)
+		printf("Semiclassical QFT, %zu shots: %.3lf s\n", shots, time);
+	if(code == SUCCESS && strcmp(output_file, "-") != 0)
+		code = batch_write_vectors(portion, number_of_qubits, std::vector<std::string>(1, output_file));
+	myfree(portion);
+	return code;
+}
+
+// Матрица плотности: шум --noise учитывается точно, без траекторий. Выходной файл (если не "-") - вектор 2n кубитов
+int run_density(const char *input_file, const char *output_file, const size_t number_of_qubits, const solve_options *options)
+{
+	std::vector<gate> gates;
+	int code = load_noisy_gates(options, number_of_qubits, gates);
+	if(code != SUCCESS)
+		return code;
+	complexd *rho = NULL;
+	std::vector<complexd> psi(1UL << number_of_qubits);
+	if((code = mymalloc(&rho, 2 * number_of_qubits)) != SUCCESS)
+		return code;
+	code = read_full_vector(psi.data(), number_of_qubits, input_file);
+	if(code == SUCCESS)
+	{
+		density_from_pure(rho, number_of_qubits, psi.data());
+		code = density_apply(rho, number_of_qubits, gates.data(), gates.size(), &options->noise);
+	}
+	if(code == SUCCESS)
+	{
+		const double trace = density_trace(rho, number_of_qubits), purity = density_purity(rho, number_of_qubits);
+		if(i_am_the_master)
+			printf("Density matrix: trace %.12lf, purity %.12lf", trace, purity);
+		if(strcmp(options->density_reference, "-") != 0)
+		{
+			code = read_full_vector(psi.data(), number_of_qubits, options->density_reference);
+			if(code == SUCCESS)
+			{
+				const double fid = density_fidelity(rho, number_of_qubits, psi.data());
+				if(i_am_the_master)
+					printf(", fidelity with %s %.12lf", options->density_reference, fid);
+			}
+		}
+		if(i_am_the_master)
+			printf("\n");
+	}
+	if(code == SUCCESS && strcmp(output_file, "-") != 0)
+		code = batch_write_vectors(rho, 2 * number_of_qubits, std::vector<std::string>(1, output_file));
+	myfree(rho);
+	return code;
+}
+
+// Вектор хранится по блокам в storage; в памяти держатся только буферы проходов
+int run_blocked(const char *input_file, const char *output_file, const size_t number_of_qubits, const std::vector<gate> &gates, block_storage *storage, const ulong block_size)
+{
+	blocked_state state;
+	int code = blocked_init(&state, number_of_qubits, storage, block_size);
+	if(code != SUCCESS)
+		return code;
+	code = blocked_read_vector_from_file(&state, input_file);
+	if(code == SUCCESS)
+		code = blocked_apply_circuit(&state, gates.data(), gates.size());
+	if(code == SUCCESS)
+		code = blocked_write_vector_to_file(&state, output_file);
+	if(i_am_the_master)
+		printf("Blocked: block of %lu elements, %lu passes, %lu qubit swaps\n", state.block_size, state.passes, state.swaps);
+	blocked_clean(&state);
+	return code;
+}
+
+// Часть вектора лежит в файле на локальном диске, в памяти держится memory_mb мегабайт
+int run_out_of_core(const char *input_file, const char *output_file, const size_t number_of_qubits, const std::vector<gate> &gates, const char *prefix, const size_t memory_mb)
+{
+	ulong block_size = blocked_block_size(number_of_qubits, memory_mb);
+	file_storage storage;
+	int code = collective_code(storage.open(prefix, (1UL << number_of_qubits) / proc_num, block_size));
+	if(code == SUCCESS)
+		code = run_blocked(input_file, output_file, number_of_qubits, gates, &storage, block_size);
+	storage.close();
+	return code;
+}
+
+// Часть вектора хранится в памяти сжатыми блоками, распакованные блоки занимают memory_mb мегабайт
+int run_compressed(const char *input_file, const char *output_file, const size_t number_of_qubits, const std::vector<gate> &gates, const size_t memory_mb, const double error_bound)
+{
+	ulong portion_size = (1UL << number_of_qubits) / proc_num;
+	ulong block_size = blocked_block_size(number_of_qubits, memory_mb);
+	compressed_storage storage;
+	int code = storage.init(portion_size, block_size, error_bound);
+	if(code == SUCCESS)
+		code = run_blocked(input_file, output_file, number_of_qubits, gates, &storage, block_size);
+	// степень сжатия после преобразования, по всем процессам
+	ulong bytes = storage.compressed_bytes(), all_bytes = 0;
+	MPI_Reduce(&bytes, &all_bytes, 1, MPI_UNSIGNED_LONG, MPI_SUM, MASTER, MPI_COMM_WORLD);
+	if(code == SUCCESS && i_am_the_master)
+		printf("Compressed: %lu bytes, ratio %.2lf\n", all_bytes, double(portion_size * proc_num * sizeof(complexd)) / all_bytes);
+	return code;
+}
+
+// Ненулевые амплитуды хранятся в хеш-таблицах; при доле ненулевых больше density вектор становится плотным
+// Вход - файл или, если basis, базисное состояние |basis_index>; выходной файл "-" - вектор не пишется
+int run_sparse(const char *input_file, const char *output_file, const size_t number_of_qubits, const std::vector<gate> &gates, const double density,
+	const bool basis, const ulong basis_index)
+{
+	sparse_state state;
+	int code = sparse_init(&state, number_of_qubits);
+	if(code == SUCCESS && basis) {
+		if(basis_index >> number_of_qubits != 0) {
+			if(i_am_the_master)
+				fprintf(stderr, "Basis state %lu does not fit %zu qubits\n", basis_index, number_of_qubits);
+			return WRONG_VALUE;
+		}
+		code = sparse_set_basis(&state, basis_index);
+	}
+	else if(code == SUCCESS)
+		code = sparse_read_vector_from_file(&state, input_file);
+	if(code != SUCCESS)
+		return code;
+	ulong nonzero = sparse_count(&state);
+	complexd *portion = NULL;
+	code = sparse_apply_circuit(&state, gates.data(), gates.size(), density, &portion);
+	if(code != SUCCESS)
+		return code;
+	const bool write = strcmp(output_file, "-") != 0;
+	if(portion != NULL) {
+		if(write)
+			code = write_vector_to_file(portion, number_of_qubits, output_file);
+		myfree(portion);
+	}
+	else {
+		ulong result = sparse_count(&state);
+		if(i_am_the_master)
+			printf("Sparse: %lu -> %lu nonzero amplitudes\n", nonzero, result);
+		if(write)
+			code = sparse_write_vector_to_file(&state, output_file);
+	}
+	return code;
+}
+
+// Одна схема над многими векторами: по batch_states векторов за проход, все векторы пачки
+// обрабатываются каждым ядром за одно чтение и пересылаются одним сообщением
+int run_batch(const char *list_file, const size_t batch_states, const size_t number_of_qubits, const std::vector<gate> &gates)
+{
+	std::vector<std::string> inputs, outputs;
+	int code = read_batch_list(list_file, inputs, outputs);
+	if(code != SUCCESS)
+		return code;
+	const size_t states = std::min(batch_states, inputs.size());
+	complexd *portion = NULL;
+	if((code = batch_alloc(&portion, number_of_qubits, states)) != SUCCESS)
+		return code;
+	size_t first, passes = 0;
+	for(first = 0; first < inputs.size() && code == SUCCESS; first += states, passes++)
+	{
+		size_t last = std::min(first + states, inputs.size());
+		std::vector<std::string> batch_inputs(inputs.begin() + first, inputs.begin() + last);
+		std::vector<std::string> batch_outputs(outputs.begin() + first, outputs.begin() + last);
+		code = batch_read_vectors(portion, number_of_qubits, batch_inputs);
+		if(code == SUCCESS)
+			code = apply_circuit_batch(portion, batch_inputs.size(), number_of_qubits, gates.data(), gates.size());
+		if(code == SUCCESS)
+			code = batch_write_vectors(portion, number_of_qubits, batch_outputs);
+	}
+	batch_free(portion);
+	if(code == SUCCESS && i_am_the_master)
+		printf("Batch: %zu vectors in %zu passes\n", inputs.size(), passes);
+	return code;
+}
+
+// Оценка времени, памяти и обменов для схемы без ее выполнения; входной вектор не нужен
+int run_estimate(const solve_options *options, const size_t number_of_qubits)
+{
+	const int processes = options->estimate_processes;
+	if(processes <= 0 || (processes & (processes - 1)) || ulong(processes) > (1UL << number_of_qubits) || options->estimate_threads <= 0) {
+		if(i_am_the_master)
+			fprintf(stderr, "%s\n", "Number of processes must be a power of 2 not above 2^number_of_qubits");
+		return WRONG_VALUE;
+	}
+	kernel_costs costs;
+	default_costs(&costs);
+	int code = SUCCESS;
+	if(options->costs_file != NULL && (code = read_costs(&costs, options->costs_file)) != SUCCESS)
+		return code;
+	std::vector<gate> gates;
+	if(options->circuit_file != NULL)
+		code = read_circuit(options->circuit_file, number_of_qubits, gates);
+	else
+		qft_circuit(number_of_qubits, gates);
+	if(code != SUCCESS)
+		return code;
+	// как в run_circuit: пачки оптимизируются и выполняются по отдельности
+	circuit_estimate estimate;
+	estimate_init(&estimate);
+	size_t first;
+	for(first = 0; first < gates.size(); first += CIRCUIT_BATCH)
+	{
+		std::vector<gate> batch(gates.begin() + first, gates.begin() + std::min(first + CIRCUIT_BATCH, gates.size()));
+		if(options->circuit_file != NULL && !options->no_optimize) {
+			optimize_circuit(batch, number_of_qubits);
+			schedule_circuit(batch, number_of_qubits, processes);
+		}
+		estimate_circuit(batch.data(), batch.size(), number_of_qubits, processes, options->estimate_threads, &costs, &estimate);
+	}
+	if(i_am_the_master) {
+		const double mb = 1024.0 * 1024.0;
+		printf("Estimate for %zu qubits on %d processes x %d threads:\n", number_of_qubits, processes, options->estimate_threads);
+		printf("  gates: %zu, memory sweeps: %zu, exchanges: %zu\n", estimate.gates, estimate.sweeps, estimate.exchanges);
+		printf("  memory per process: %.1lf MiB\n", estimate.memory_per_process / mb);
+		printf("  communicated: %.1lf MiB\n", estimate.bytes_communicated / mb);
+		printf("  runtime: %.3lf s (sweeps %.3lf s, exchanges %.3lf s)\n", estimate.sweep_seconds + estimate.exchange_seconds,
+			estimate.sweep_seconds, estimate.exchange_seconds);
+	}
+	return SUCCESS;
+}
+
+// Измеряет стоимости ядер на текущих процессах и потоках для --estimate
+int run_calibrate(const char *costs_file, const size_t number_of_qubits)
+{
+	kernel_costs costs;
+	int code = calibrate_costs(&costs, number_of_qubits);
+	if(code == SUCCESS && i_am_the_master) {
+		code = write_costs(&costs, costs_file);
+		printf("Calibrated: thread %.2lf GB/s, process %.2lf GB/s, network %.2lf GB/s, latency %.2lf us\n", costs.thread_bandwidth / 1e9,
+			costs.memory_bandwidth / 1e9, costs.network_bandwidth / 1e9, costs.network_latency * 1e6);
+	}
+	return code;
+}
+
 void usage() {
-	printf("Usage: solve <input_file> <output_file> <number_of_qubits>\n");
+	printf("Usage: solve <input_file> <output_file> <number_of_qubits> [options]\n");
+	printf("       solve --manifest <file> [--circuit <file.qasm>] [--no-optimize] [--checkpoints <memory_mb> [--spill <path_prefix> <disk_mb>]]\n");
+	printf("                                        run every \"<input_file> <output_file> [<circuit.qasm>] <number_of_qubits>\" line in one run;\n");
+	printf("                                        --checkpoints resumes each job from the longest cached state of a common circuit prefix\n");
+	printf("       solve --serve <socket_path> <number_of_qubits> [--no-optimize]\n");
+	printf("                                        keep the state resident and run commands sent over a Unix socket\n");
+	printf("Options:\n");
+	printf("  --circuit <file.qasm>                 run an OpenQASM 2 circuit instead of QFT\n");
+	printf("  --no-optimize                         do not simplify or reorder the circuit before running it\n");
+	printf("  --seed <seed>                         measurement outcomes are reproducible for any number of processes\n");
+	printf("  --out-of-core <path_prefix> <memory_mb> keep the state in files <path_prefix>.<rank>\n");
+	printf("  --compressed <memory_mb> <error_bound>  keep the state in compressed blocks (0 - lossless, else >= 1e-15);\n");
+	printf("                                        each pass that changes a block may add up to <error_bound> per component\n");
+	printf("  --sparse <promote_density>            keep only nonzero amplitudes until their share exceeds the density\n");
+	printf("  --basis <index>                       with --sparse: start from the basis state |index> instead of <input_file>;\n");
+	printf("                                        <output_file> \"-\" - not written (for 40-60 qubits)\n");
+	printf("  --batch <list_file> <states>          run on every \"input output\" pair of the list, <states> vectors per pass\n");
+	printf("  --shm <name>                          leave the final state in POSIX shared memory for view and fidelity\n");
+	printf("                                        instead of writing <output_file>; all processes must share one node\n");
+	printf("  --amplitudes <m1,m2,...>              compute only these QFT output amplitudes from the input in one pass;\n");
+	printf("                                        <output_file> other than \"-\" is spot-checked against them\n");
+	printf("  --trajectories <count> <states>       Monte Carlo noise trajectories, <states> of them per pass; <output_file> is unused\n");
+	printf("  --noise <rotation> <depolarizing> <damping>  noise after every gate: rotation error deviation,\n");
+	printf("                                        Pauli error probability, amplitude damping gamma\n");
+	printf("  --noise-from <gate>                   gates before this one run without noise once for all trajectories\n");
+	printf("  --grover <m1,m2,...|mask:value> <iterations>  Grover steps on the input: phase flip of the listed indices\n");
+	printf("                                        (or of those with index & mask == value) and reflection about the mean;\n");
+	printf("                                        0 iterations - the optimal number, <output_file> \"-\" - not written\n");
+	printf("  --qaoa <graph_file> <gamma1,beta1,...>  MaxCut QAOA layers on the input (\"-\" - uniform superposition);\n");
+	printf("                                        graph lines are \"u v [weight]\" with vertices 1..<number_of_qubits>\n");
+	printf("  --trotter <hamiltonian_file> <time> <steps> <order>  exp(-iHt) by Trotter steps of order 1 or 2;\n");
+	printf("                                        Hamiltonian lines are \"coefficient PAULIS\", e.g. \"0.5 ZZII\"\n");
+	printf("  --observe <P1,P2,...> <every>         with --trotter: Pauli expectations every <every> steps (0 - at the end)\n");
+	printf("  --gradient <hamiltonian_file>         <H> of the circuit output and its derivatives by every RX, RZ and CP angle\n");
+	printf("                                        (adjoint method, circuit as written); <output_file> is unused\n");
+	printf("  --oracle <modexp:a:N:x_qubits|add:k>  permutation of basis states as one distributed move:\n");
+	printf("                                        |x>|y> -> |x>|y*a^x mod N> (x - first x_qubits qubits) or |i> -> |i+k>\n");
+	printf("  --semiclassical <shots>               measured QFT of the input: one phase, Hadamard and measurement per qubit\n");
+	printf("                                        instead of controlled rotations (with --seed for reproducible outcomes)\n");
+	printf("  --density <reference_file|->          exact density matrix with --noise as a 2n-qubit vector written to <output_file>\n");
+	printf("                                        (\"-\" - not written); trace, purity and fidelity with the reference\n");
+	printf("  --estimate <processes> <threads>      predict runtime, memory and communication instead of running\n");
+	printf("  --costs <file>                        kernel costs for --estimate, written by --calibrate\n");
+	printf("  --calibrate <file>                    measure kernel costs on this configuration and write them\n");
+}
+
+// Ключ режима mode; режим точки входа или другой ключ режима уже выбран - ошибка
+static bool select_mode(solve_options *options, const solve_mode mode)
+{
+	if(options->mode != SOLVE_QFT)
+		return false;
+	options->mode = mode;
+	return true;
+}
+
+// Точка входа по argv[1] и параметры после ее обязательных аргументов
+bool parse_options(const int argc, char *argv[], solve_options *options)
+{
+	memset(options, 0, sizeof(*options));
+	int k;
+	if(argc >= 3 && strcmp(argv[1], "--manifest") == 0) {
+		options->mode = SOLVE_MANIFEST;
+		k = 3;
+	}
+	else if(argc >= 4 && strcmp(argv[1], "--serve") == 0) {
+		options->mode = SOLVE_SERVE;
+		k = 4;
+	}
+	else if(argc >= 4)
+		k = 4;
+	else
+		return false;
+	while(k < argc)
+	{
+		if(strcmp(argv[k], "--circuit") == 0 && k + 1 < argc) {
+			options->circuit_file = argv[k + 1];
+			k += 2;
+		}
+		else if(strcmp(argv[k], "--no-optimize") == 0) {
+			options->no_optimize = true;
+			k++;
+		}
+		else if(strcmp(argv[k], "--out-of-core") == 0 && k + 2 < argc) {
+			if(!select_mode(options, SOLVE_OUT_OF_CORE))
+				return false;
+			options->ooc_prefix = argv[k + 1];
+			options->memory_mb = atoi(argv[k + 2]);
+			k += 3;
+		}
+		else if(strcmp(argv[k], "--compressed") == 0 && k + 2 < argc) {
+			if(!select_mode(options, SOLVE_COMPRESSED))
+				return false;
+			options->compressed = true;
+			options->memory_mb = atoi(argv[k + 1]);
+			options->error_bound = atof(argv[k + 2]);
+			k += 3;
+		}
+		else if(strcmp(argv[k], "--estimate") == 0 && k + 2 < argc) {
+			if(!select_mode(options, SOLVE_ESTIMATE))
+				return false;
+			options->estimate_processes = atoi(argv[k + 1]);
+			options->estimate_threads = atoi(argv[k + 2]);
+			k += 3;
+		}
+		else if(strcmp(argv[k], "--batch") == 0 && k + 2 < argc) {
+			if(!select_mode(options, SOLVE_BATCH))
+				return false;
+			options->batch_file = argv[k + 1];
+			options->batch_states = atoi(argv[k + 2]);
+			k += 3;
+		}
+		else if(strcmp(argv[k], "--shm") == 0 && k + 1 < argc) {
+			if(!select_mode(options, SOLVE_SHARED))
+				return false;
+			options->shm_name = argv[k + 1];
+			k += 2;
+		}
+		else if(strcmp(argv[k], "--amplitudes") == 0 && k + 1 < argc) {
+			if(!select_mode(options, SOLVE_AMPLITUDES))
+				return false;
+			options->amplitudes = argv[k + 1];
+			k += 2;
+		}
+		else if(strcmp(argv[k], "--trajectories") == 0 && k + 2 < argc) {
+			if(!select_mode(options, SOLVE_NOISE))
+				return false;
+			options->trajectories = atoi(argv[k + 1]);
+			options->trajectory_states = atoi(argv[k + 2]);
+			k += 3;
+		}
+		else if(strcmp(argv[k], "--noise") == 0 && k + 3 < argc) {
+			options->noise.rotation = atof(argv[k + 1]);
+			options->noise.depolarizing = atof(argv[k + 2]);
+			options->noise.damping = atof(argv[k + 3]);
+			k += 4;
+		}
+		else if(strcmp(argv[k], "--noise-from") == 0 && k + 1 < argc) {
+			options->noise_from = atoi(argv[k + 1]);
+			k += 2;
+		}
+		else if(strcmp(argv[k], "--grover") == 0 && k + 2 < argc) {
+			if(!select_mode(options, SOLVE_GROVER))
+				return false;
+			options->grover_oracle = argv[k + 1];
+			options->grover_iterations = atoi(argv[k + 2]);
+			k += 3;
+		}
+		else if(strcmp(argv[k], "--qaoa") == 0 && k + 2 < argc) {
+			if(!select_mode(options, SOLVE_QAOA))
+				return false;
+			options->qaoa_graph = argv[k + 1];
+			options->qaoa_angles = argv[k + 2];
+			k += 3;
+		}
+		else if(strcmp(argv[k], "--trotter") == 0 && k + 4 < argc) {
+			if(!select_mode(options, SOLVE_TROTTER))
+				return false;
+			options->hamiltonian_file = argv[k + 1];
+			options->evolution_time = atof(argv[k + 2]);
+			options->trotter_steps = atoi(argv[k + 3]);
+			options->trotter_order = atoi(argv[k + 4]);
+			k += 5;
+		}
+		else if(strcmp(argv[k], "--observe") == 0 && k + 2 < argc) {
+			options->observables = argv[k + 1];
+			options->observe_every = atoi(argv[k + 2]);
+			k += 3;
+		}
+		else if(strcmp(argv[k], "--gradient") == 0 && k + 1 < argc) {
+			if(!select_mode(options, SOLVE_GRADIENT))
+				return false;
+			options->gradient_hamiltonian = argv[k + 1];
+			k += 2;
+		}
+		else if(strcmp(argv[k], "--seed") == 0 && k + 1 < argc) {
+			options->seeded = true;
+			options->seed = strtoul(argv[k + 1], NULL, 10);
+			k += 2;
+		}
+		else if(strcmp(argv[k], "--oracle") == 0 && k + 1 < argc) {
+			if(!select_mode(options, SOLVE_ORACLE))
+				return false;
+			options->oracle = argv[k + 1];
+			k += 2;
+		}
+		else if(strcmp(argv[k], "--semiclassical") == 0 && k + 1 < argc) {
+			if(!select_mode(options, SOLVE_SEMICLASSICAL))
+				return false;
+			options->semiclassical_shots = atoi(argv[k + 1]);
+			k += 2;
+		}
+		else if(strcmp(argv[k], "--checkpoints") == 0 && k + 1 < argc) {
+			options->checkpoint_mb = atoi(argv[k + 1]);
+			k += 2;
+		}
+		else if(strcmp(argv[k], "--spill") == 0 && k + 2 < argc) {
+			options->spill_prefix = argv[k + 1];
+			options->spill_mb = atoi(argv[k + 2]);
+			k += 3;
+		}
+		else if(strcmp(argv[k], "--density") == 0 && k + 1 < argc) {
+			if(!select_mode(options, SOLVE_DENSITY))
+				return false;
+			options->density_reference = argv[k + 1];
+			k += 2;
+		}
+		else if(strcmp(argv[k], "--costs") == 0 && k + 1 < argc) {
+			options->costs_file = argv[k + 1];
+			k += 2;
+		}
+		else if(strcmp(argv[k], "--calibrate") == 0 && k + 1 < argc) {
+			if(!select_mode(options, SOLVE_CALIBRATE))
+				return false;
+			options->calibrate_file = argv[k + 1];
+			k += 2;
+		}
+		else if(strcmp(argv[k], "--sparse") == 0 && k + 1 < argc) {
+			if(!select_mode(options, SOLVE_SPARSE))
+				return false;
+			options->sparse = true;
+			options->density = atof(argv[k + 1]);
+			k += 2;
+		}
+		else if(strcmp(argv[k], "--basis") == 0 && k + 1 < argc) {
+			options->basis = true;
+			options->basis_index = strtoul(argv[k + 1], NULL, 0);
+			k += 2;
+		}
+		else
+			return false;
+	}
+	if(options->mode == SOLVE_QFT && options->circuit_file != NULL)
+		options->mode = SOLVE_CIRCUIT;
+	const solve_mode mode = options->mode;
+	// схему из файла заменяет своя схема режима; сервер получает схемы командами
+	const bool own_circuit = mode == SOLVE_AMPLITUDES || mode == SOLVE_GROVER || mode == SOLVE_QAOA || mode == SOLVE_TROTTER
+		|| mode == SOLVE_ORACLE || mode == SOLVE_SEMICLASSICAL || mode == SOLVE_SERVE;
+	return (options->circuit_file == NULL || !own_circuit)
+		&& (mode != SOLVE_TROTTER || (options->trotter_steps > 0 && (options->trotter_order == 1 || options->trotter_order == 2)))
+		&& (options->observables == NULL || mode == SOLVE_TROTTER)
+		&& (options->checkpoint_mb == 0 || mode == SOLVE_MANIFEST)
+		&& (options->spill_prefix == NULL || options->checkpoint_mb > 0)
+		&& (!options->basis || mode == SOLVE_SPARSE)
+		&& (mode != SOLVE_NOISE || (options->trajectories > 0 && options->trajectory_states > 0))
+		&& (mode != SOLVE_SEMICLASSICAL || options->semiclassical_shots > 0)
+		&& options->noise.rotation >= 0 && options->noise.depolarizing >= 0 && options->noise.depolarizing <= 1
+		&& options->noise.damping >= 0 && options->noise.damping <= 1
+		&& (mode != SOLVE_BATCH || options->batch_states > 0);
 }
 
 int main(int argc, char *argv[])
@@ -40,22 +1205,91 @@ int main(int argc, char *argv[])
     MPI_Comm_rank (MPI_COMM_WORLD, &myrank);
     MPI_Comm_size (MPI_COMM_WORLD, &proc_num);
 	i_am_the_master = myrank == MASTER;
-	if(argc != 4) {
+	solve_options options;
+	if(!parse_options(argc, argv, &options)) {
 		if(i_am_the_master)
 			usage();
 	}
 	else {
 	    functions_init(myrank, proc_num, i_am_the_master);
+		if(options.seeded)
+			measurement_seed(options.seed);
 		assert(MPI_DATATYPE_NULL != MPI_DOUBLE_COMPLEX);
 
-		size_t number_of_qubits = atoi(argv[3]);
-		//
-		// Тестируем QFT
-		test_qft(argv[1], argv[2], number_of_qubits);
-		// 
-		//
+		// у --manifest число кубитов задает каждое задание
+		const size_t number_of_qubits = options.mode == SOLVE_MANIFEST ? 0 : atoi(argv[3]);
+		std::vector<gate> gates;
+		switch(options.mode)
+		{
+		case SOLVE_MANIFEST:
+			// в манифесте каждое задание выполняется обычным вектором
+			run_manifest(&options, argv[2]);
+			break;
+		case SOLVE_SERVE:
+			serve(argv[2], number_of_qubits, !options.no_optimize);
+			break;
+		case SOLVE_CALIBRATE:
+			run_calibrate(options.calibrate_file, number_of_qubits);
+			break;
+		case SOLVE_ESTIMATE:
+			run_estimate(&options, number_of_qubits);
+			break;
+		case SOLVE_BATCH:
+			if(load_gates(&options, number_of_qubits, gates) == SUCCESS)
+				run_batch(options.batch_file, options.batch_states, number_of_qubits, gates);
+			break;
+		case SOLVE_OUT_OF_CORE:
+			if(load_gates(&options, number_of_qubits, gates) == SUCCESS)
+				run_out_of_core(argv[1], argv[2], number_of_qubits, gates, options.ooc_prefix, options.memory_mb);
+			break;
+		case SOLVE_COMPRESSED:
+			if(load_gates(&options, number_of_qubits, gates) == SUCCESS)
+				run_compressed(argv[1], argv[2], number_of_qubits, gates, options.memory_mb, options.error_bound);
+			break;
+		case SOLVE_SPARSE:
+			if(load_gates(&options, number_of_qubits, gates) == SUCCESS)
+				run_sparse(argv[1], argv[2], number_of_qubits, gates, options.density, options.basis, options.basis_index);
+			break;
+		case SOLVE_NOISE:
+			run_noise(argv[1], number_of_qubits, &options);
+			break;
+		case SOLVE_GROVER:
+			run_grover(argv[1], argv[2], number_of_qubits, options.grover_oracle, options.grover_iterations);
+			break;
+		case SOLVE_QAOA:
+			run_qaoa(argv[1], argv[2], number_of_qubits, options.qaoa_graph, options.qaoa_angles);
+			break;
+		case SOLVE_TROTTER:
+			run_trotter(argv[1], argv[2], number_of_qubits, &options);
+			break;
+		case SOLVE_GRADIENT:
+			run_gradient(argv[1], number_of_qubits, &options);
+			break;
+		case SOLVE_ORACLE:
+			run_oracle(argv[1], argv[2], number_of_qubits, options.oracle);
+			break;
+		case SOLVE_SEMICLASSICAL:
+			run_semiclassical(argv[1], argv[2], number_of_qubits, options.semiclassical_shots);
+			break;
+		case SOLVE_DENSITY:
+			run_density(argv[1], argv[2], number_of_qubits, &options);
+			break;
+		case SOLVE_AMPLITUDES:
+			run_amplitudes(argv[1], argv[2], number_of_qubits, options.amplitudes);
+			break;
+		case SOLVE_SHARED:
+			run_shared(argv[1], number_of_qubits, &options);
+			break;
+		case SOLVE_CIRCUIT:
+			run_circuit(argv[1], argv[2], number_of_qubits, options.circuit_file, !options.no_optimize);
+			break;
+		case SOLVE_QFT:
+			// Тестируем QFT
+			test_qft(argv[1], argv[2], number_of_qubits);
+			break;
+		}
 		functions_clean();
 	}
 	MPI_Finalize();
 	return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,92 @@
+#include "manifest.h"
+#include "batch.h"
+
+#include <algorithm>
+#include <cstring>
+#include <future>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+
+int read_manifest(const char *filename, const size_t files_num, std::vector<manifest_job> &jobs, const size_t optional_files)
+{
+	FILE *f = fopen(filename, "r");
+	if(f == NULL) {
+		fprintf(stderr, "Cannot open file %s\n", filename);
+		return errno;
+	}
+	char line[8192];
+	int code = SUCCESS;
+	size_t line_num = 0;
+	while(code == SUCCESS && fgets(line, sizeof(line), f) != NULL)
+	{
+		line_num++;
+		std::vector<char *> fields;
+		char *field;
+		for(field = strtok(line, " \t\r\n"); field != NULL; field = strtok(NULL, " \t\r\n"))
+			fields.push_back(field);
+		if(fields.empty() || fields[0][0] == '#')
+			continue;
+		manifest_job job;
+		char *end = NULL;
+		long qubits = fields.size() >= files_num + 1 && fields.size() <= files_num + optional_files + 1 ? strtol(fields.back(), &end, 10) : 0;
+		// часть вектора на каждом процессе должна быть непустой
+		if(end == NULL || *end != '\0' || qubits <= 0 || qubits >= 63 || (1UL << qubits) < ulong(proc_num)) {
+			fprintf(stderr, "Wrong job at line %zu of %s: expected %zu files and a number of qubits\n", line_num, filename, files_num);
+			code = WRONG_VALUE;
+			break;
+		}
+		job.files.assign(fields.begin(), fields.end() - 1);
+		job.number_of_qubits = qubits;
+		jobs.push_back(job);
+	}
+	fclose(f);
+	if(code == SUCCESS && jobs.empty()) {
+		fprintf(stderr, "No jobs listed in %s\n", filename);
+		code = WRONG_VALUE;
+	}
+	return code;
+}
+
+// Только чтение файлов своим процессом, без MPI: выполняется в отдельном потоке
+static int read_inputs(const manifest_job *job, const size_t inputs, complexd **vectors)
+{
+	int code = SUCCESS;
+	size_t s;
+	for(s = 0; s < inputs && code == SUCCESS; s++)
+		code = batch_read_portion(vectors[s], job->number_of_qubits, 1, 0, job->files[s].c_str());
+	return code;
+}
+
+int manifest_run(const std::vector<manifest_job> &jobs, const size_t inputs, const size_t vectors,
+	manifest_job_function process, void *arg)
+{
+	size_t max_qubits = 0, k, s;
+	for(k = 0; k < jobs.size(); k++)
+		max_qubits = std::max(max_qubits, jobs[k].number_of_qubits);
+	const ulong max_portion_size = (1UL << max_qubits) / proc_num;
+	// два набора буферов: в одном обрабатывается задание, в другой читается следующее
+	complexd *buffers = NULL;
+	int code = collective_code(batch_alloc(&buffers, max_qubits, 2 * vectors));
+	if(code != SUCCESS) {
+		batch_free(buffers);
+		return code;
+	}
+	std::vector<complexd *> slot[2];
+	for(k = 0; k < 2; k++)
+		for(s = 0; s < vectors; s++)
+			slot[k].push_back(buffers + (k * vectors + s) * max_portion_size);
+	code = collective_code(jobs.empty() ? SUCCESS : read_inputs(&jobs[0], inputs, slot[0].data()));
+	for(k = 0; k < jobs.size() && code == SUCCESS; k++)
+	{
+		std::future<int> reading;
+		if(k + 1 < jobs.size() && inputs > 0)
+			reading = std::async(std::launch::async, read_inputs, &jobs[k + 1], inputs, slot[(k + 1) % 2].data());
+		code = process(jobs[k], slot[k % 2].data(), arg);
+		const int read_code = collective_code(reading.valid() ? reading.get() : SUCCESS);
+		if(code == SUCCESS)
+			code = read_code;
+	}
+	batch_free(buffers);
+	return code;
+}
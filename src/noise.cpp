@@ -0,0 +1,212 @@
+#include "noise.h"
+#include "batch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdio.h>
+
+void noise_statistics_init(noise_statistics *stats)
+{
+	stats->trajectories = 0;
+	stats->mean = 0;
+	stats->m2 = 0;
+	stats->min = 1;
+}
+
+double noise_statistics_std(const noise_statistics *stats)
+{
+	return stats->trajectories > 1 ? sqrt(stats->m2 / (stats->trajectories - 1)) : 0;
+}
+
+static void statistics_add(noise_statistics *stats, const double value)
+{
+	stats->trajectories++;
+	const double delta = value - stats->mean;
+	stats->mean += delta / stats->trajectories;
+	stats->m2 += delta * (value - stats->mean);
+	stats->min = std::min(stats->min, value);
+}
+
+// К биту mask вектора s пачки применяется матрица matrices[4*s .. 4*s+3]
+static void apply_per_state(complexd *portion, const ulong portion_size, const size_t states, const ulong mask, const complexd *matrices)
+{
+	long i;
+	const long pairs = portion_size / 2;
+	#pragma omp parallel for
+	for(i = 0; i < pairs; i++)
+	{
+		const ulong index0 = insert_zero(i, mask);
+		complexd *a0 = portion + index0 * states, *a1 = portion + (index0 | mask) * states;
+		size_t s;
+		for(s = 0; s < states; s++)
+		{
+			const complexd *m = matrices + 4 * s;
+			const complexd x = a0[s], y = a1[s];
+			a0[s] = m[0] * x + m[1] * y;
+			a1[s] = m[2] * x + m[3] * y;
+		}
+	}
+}
+
+// Вероятность единицы в бите mask у каждого вектора пачки
+static void probabilities_of_one(const complexd *portion, const ulong portion_size, const size_t states, const ulong mask, std::vector<double> &p1)
+{
+	p1.assign(states, 0.0);
+	long i;
+	const long size = portion_size;
+	#pragma omp parallel
+	{
+		std::vector<double> local(states, 0.0);
+		size_t s;
+		#pragma omp for
+		for(i = 0; i < size; i++)
+			if(i & mask)
+				for(s = 0; s < states; s++)
+					local[s] += std::norm(portion[i * states + s]);
+		#pragma omp critical
+		for(s = 0; s < states; s++)
+			p1[s] += local[s];
+	}
+	MPI_Allreduce(MPI_IN_PLACE, p1.data(), states, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+}
+
+static void multiply(const complexd *a, complexd *m)
+{
+	const complexd result[4] = { a[0] * m[0] + a[1] * m[2], a[0] * m[1] + a[1] * m[3], a[2] * m[0] + a[3] * m[2], a[2] * m[1] + a[3] * m[3] };
+	std::copy(result, result + 4, m);
+}
+
+// Ошибка поворота и деполяризация одной траектории, слитые в одну матрицу; вызывается на рутовом процессе
+static void unitary_noise(const noise_model *model, complexd *m)
+{
+	m[0] = m[3] = 1;
+	m[1] = m[2] = 0;
+	if(model->rotation > 0)
+	{
+		const double theta = normal() * model->rotation;
+		const complexd rotation[4] = { cos(theta), sin(theta), -sin(theta), cos(theta) };
+		multiply(rotation, m);
+	}
+	if(model->depolarizing > 0 && rand() / (RAND_MAX + 1.0) < model->depolarizing)
+	{
+		const complexd i_unit(0, 1);
+		const complexd paulis[3][4] = { { 0, 1, 1, 0 }, { 0, -i_unit, i_unit, 0 }, { 1, 0, 0, -1 } };
+		multiply(paulis[rand() % 3], m);
+	}
+}
+
+// Шум на кубите qubit при текущем расположении; upcoming - оставшаяся часть схемы, для выбора локального бита
+static int noise_on_qubit(complexd *portion, const size_t states, qubit_layout *layout, const size_t qubit,
+	const gate *upcoming, const size_t count, const noise_model *model, std::vector<complexd> &matrices, std::vector<double> &p1)
+{
+	const ulong portion_size = 1UL << layout->local_bits;
+	int code = batch_localize_qubit(portion, states, layout, qubit, upcoming, count);
+	const ulong mask = 1UL << layout->bit_of[qubit];
+	size_t s;
+	if(code == SUCCESS && (model->rotation > 0 || model->depolarizing > 0))
+	{
+		if(i_am_the_master)
+			for(s = 0; s < states; s++)
+				unitary_noise(model, &matrices[4 * s]);
+		MPI_Bcast(matrices.data(), 4 * states, MPI_DOUBLE_COMPLEX, MASTER, MPI_COMM_WORLD);
+		apply_per_state(portion, portion_size, states, mask, matrices.data());
+	}
+	if(code == SUCCESS && model->damping > 0)
+	{
+		probabilities_of_one(portion, portion_size, states, mask, p1);
+		if(i_am_the_master)
+			for(s = 0; s < states; s++)
+			{
+				complexd *m = &matrices[4 * s];
+				const double jump = model->damping * p1[s];
+				m[1] = m[2] = m[3] = 0;
+				m[0] = 0;
+				if(rand() / (RAND_MAX + 1.0) < jump)
+					// |1> -> |0>
+					m[1] = 1 / sqrt(p1[s]);
+				else {
+					m[0] = 1 / sqrt(1 - jump);
+					m[3] = sqrt(1 - model->damping) / sqrt(1 - jump);
+				}
+			}
+		MPI_Bcast(matrices.data(), 4 * states, MPI_DOUBLE_COMPLEX, MASTER, MPI_COMM_WORLD);
+		apply_per_state(portion, portion_size, states, mask, matrices.data());
+	}
+	return code;
+}
+
+int run_trajectories(const complexd *start, const complexd *ideal, const size_t number_of_qubits, const gate *gates, const size_t count,
+	const noise_model *model, const size_t states, noise_statistics *stats)
+{
+	const ulong portion_size = (1UL << number_of_qubits) / proc_num;
+	complexd *portion = NULL;
+	int code = batch_alloc(&portion, number_of_qubits, states);
+	if(code != SUCCESS)
+		return code;
+	long i;
+	const long size = portion_size;
+	size_t s, k;
+	#pragma omp parallel for private(s)
+	for(i = 0; i < size; i++)
+		for(s = 0; s < states; s++)
+			portion[i * states + s] = start[i];
+	const bool noisy = model->rotation > 0 || model->depolarizing > 0 || model->damping > 0;
+	std::vector<complexd> matrices(4 * states);
+	std::vector<double> p1;
+	qubit_layout layout;
+	layout_init(&layout, number_of_qubits, portion_size);
+	// кубиты, шум на которых ждет конца текущего отрезка вентилей, в порядке вентилей
+	std::vector<size_t> pending;
+	std::vector<bool> is_pending(number_of_qubits + 1, false);
+	size_t g, run = 0;
+	for(g = 0; g <= count && code == SUCCESS; g++)
+	{
+		if(g < count && gates[g].type == GATE_MEASURE) {
+			if(i_am_the_master)
+				fprintf(stderr, "%s\n", "Measurement is not supported in noise trajectories");
+			code = WRONG_VALUE;
+			break;
+		}
+		bool flush = g == count;
+		for(k = 0; g < count && k < gates[g].qubits_num; k++)
+			flush = flush || is_pending[gates[g].qubits[k]];
+		if(flush)
+		{
+			code = apply_circuit_batch_from(portion, states, &layout, gates + run, g - run);
+			for(k = 0; k < pending.size() && code == SUCCESS; k++)
+				code = noise_on_qubit(portion, states, &layout, pending[k], gates + g, count - g, model, matrices, p1);
+			for(k = 0; k < pending.size(); k++)
+				is_pending[pending[k]] = false;
+			pending.clear();
+			run = g;
+		}
+		for(k = 0; g < count && noisy && k < gates[g].qubits_num; k++)
+		{
+			pending.push_back(gates[g].qubits[k]);
+			is_pending[gates[g].qubits[k]] = true;
+		}
+	}
+	if(code == SUCCESS)
+		code = batch_restore_layout(portion, states, &layout);
+	if(code == SUCCESS)
+	{
+		// <ideal|psi_s> всех траекторий за один проход
+		std::vector<complexd> overlaps(states, complexd(0));
+		#pragma omp parallel private(s)
+		{
+			std::vector<complexd> local(states, complexd(0));
+			#pragma omp for
+			for(i = 0; i < size; i++)
+				for(s = 0; s < states; s++)
+					local[s] += std::conj(ideal[i]) * portion[i * states + s];
+			#pragma omp critical
+			for(s = 0; s < states; s++)
+				overlaps[s] += local[s];
+		}
+		MPI_Allreduce(MPI_IN_PLACE, overlaps.data(), states, MPI_DOUBLE_COMPLEX, MPI_SUM, MPI_COMM_WORLD);
+		for(s = 0; s < states; s++)
+			statistics_add(stats, std::norm(overlaps[s]));
+	}
+	batch_free(portion);
+	return code;
+}
@@ -0,0 +1,218 @@
+#include "observe.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdio.h>
+
+int sample_state(const complexd *portion, const size_t number_of_qubits, const size_t shots, std::vector<ulong> &samples)
+{
+	const ulong portion_size = (1UL << number_of_qubits) / proc_num;
+	long i;
+	const long size = portion_size;
+	double local = 0;
+	#pragma omp parallel for reduction(+:local)
+	for(i = 0; i < size; i++)
+		local += std::norm(portion[i]);
+	// границы частей считаются одинаково на всех процессах, чтобы каждая точка досталась ровно одному
+	std::vector<double> offsets(proc_num + 1, 0.0);
+	MPI_Allgather(&local, 1, MPI_DOUBLE, offsets.data() + 1, 1, MPI_DOUBLE, MPI_COMM_WORLD);
+	int r;
+	for(r = 0; r < proc_num; r++)
+		offsets[r + 1] += offsets[r];
+	const double total = offsets[proc_num];
+	if(total <= 0) {
+		if(i_am_the_master)
+			fprintf(stderr, "%s\n", "Cannot sample a zero vector");
+		return WRONG_VALUE;
+	}
+	std::vector<double> points(shots);
+	size_t k;
+	if(i_am_the_master)
+	{
+		for(k = 0; k < shots; k++)
+			points[k] = measurement_uniform() * total;
+		std::sort(points.begin(), points.end());
+	}
+	MPI_Bcast(points.data(), shots, MPI_DOUBLE, MASTER, MPI_COMM_WORLD);
+	samples.assign(shots, 0);
+	// точки своей части: один проход по префиксным суммам
+	const bool last = myrank == proc_num - 1;
+	double sum = offsets[myrank];
+	ulong j = 0;
+	for(k = std::lower_bound(points.begin(), points.end(), offsets[myrank]) - points.begin();
+		k < shots && (last || points[k] < offsets[myrank + 1]); k++)
+	{
+		while(j + 1 < portion_size && sum + std::norm(portion[j]) <= points[k])
+			sum += std::norm(portion[j++]);
+		samples[k] = myrank * portion_size + j;
+	}
+	MPI_Allreduce(MPI_IN_PLACE, samples.data(), shots, MPI_UNSIGNED_LONG, MPI_SUM, MPI_COMM_WORLD);
+	return SUCCESS;
+}
+
+int pauli_expectation(const complexd *portion, const size_t number_of_qubits, const std::string &paulis, double *value)
+{
+	if(paulis.size() != number_of_qubits) {
+		if(i_am_the_master)
+			fprintf(stderr, "Pauli string must have %zu characters\n", number_of_qubits);
+		return WRONG_VALUE;
+	}
+	// P = i^{ny} * X^{x_mask} * Z^{z_mask}, у Y установлены обе маски
+	ulong x_mask = 0, z_mask = 0;
+	size_t ny = 0, k;
+	for(k = 0; k < number_of_qubits; k++)
+	{
+		const ulong bit = 1UL << (number_of_qubits - 1 - k);
+		switch(paulis[k])
+		{
+		case 'I':
+			break;
+		case 'X':
+			x_mask |= bit;
+			break;
+		case 'Y':
+			x_mask |= bit;
+			z_mask |= bit;
+			ny++;
+			break;
+		case 'Z':
+			z_mask |= bit;
+			break;
+		default:
+			if(i_am_the_master)
+				fprintf(stderr, "Wrong Pauli operator %c\n", paulis[k]);
+			return WRONG_VALUE;
+		}
+	}
+	const ulong portion_size = (1UL << number_of_qubits) / proc_num;
+	const ulong first_index = myrank * portion_size;
+	const ulong x_local = x_mask & (portion_size - 1);
+	// (P psi)[i] = i^{ny} * (-1)^{|j & z_mask|} * psi[j], j = i ^ x_mask: при глобальных битах X часть j у партнера
+	const int partner = myrank ^ int(x_mask / portion_size);
+	const complexd *other = portion;
+	complexd *received = NULL;
+	if(partner != myrank)
+	{
+		int code = SUCCESS;
+		try
+		{
+			received = new complexd [portion_size];
+		}
+		catch (std::bad_alloc& ba)
+		{
+			fprintf(stderr, "%s\n", "Failed to allocate memory for the partner portion");
+			code = NO_MEMORY;
+		}
+		// партнер не должен остаться в MPI_Sendrecv, если память не выделилась у одного из процессов
+		code = collective_code(code);
+		if(code != SUCCESS) {
+			delete [] received;
+			return code;
+		}
+		MPI_Status status;
+		MPI_Sendrecv(portion, portion_size, MPI_DOUBLE_COMPLEX, partner, NO_TAG, received, portion_size, MPI_DOUBLE_COMPLEX,
+			partner, NO_TAG, MPI_COMM_WORLD, &status);
+		other = received;
+	}
+	long i;
+	const long size = portion_size;
+	double re = 0, im = 0;
+	#pragma omp parallel for reduction(+:re,im)
+	for(i = 0; i < size; i++)
+	{
+		complexd term = std::conj(portion[i]) * other[i ^ x_local];
+		if(parity(((first_index | i) ^ x_mask) & z_mask))
+			term = -term;
+		re += term.real();
+		im += term.imag();
+	}
+	delete [] received;
+	double sums[2] = { re, im };
+	MPI_Allreduce(MPI_IN_PLACE, sums, 2, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+	// i^{ny}: вещественная часть после поворота фазы
+	const double rotated[4] = { sums[0], -sums[1], -sums[0], sums[1] };
+	*value = rotated[ny % 4];
+	return SUCCESS;
+}
+
+// Через столько индексов множители e^{2*pi*i*j*k/N} считаются заново, а не умножением на шаг
+#define QFT_AMPLITUDES_BLOCK 1024
+
+static ulong reverse_bits(const ulong index, const size_t number_of_qubits)
+{
+	ulong reversed = 0;
+	size_t b;
+	for(b = 0; b < number_of_qubits; b++)
+		reversed |= ((index >> b) & 1) << (number_of_qubits - 1 - b);
+	return reversed;
+}
+
+int qft_amplitudes(const complexd *portion, const size_t number_of_qubits, const std::vector<ulong> &indices, std::vector<complexd> &amplitudes)
+{
+	const size_t queries = indices.size();
+	const ulong size_all = 1UL << number_of_qubits;
+	const ulong portion_size = size_all / proc_num;
+	const ulong first_index = myrank * portion_size;
+	const double angle = 2 * acos(-1.0) / size_all;
+	size_t q;
+	std::vector<ulong> frequencies(queries);
+	std::vector<double> step_re(queries), step_im(queries);
+	for(q = 0; q < queries; q++)
+	{
+		if(indices[q] >= size_all) {
+			if(i_am_the_master)
+				fprintf(stderr, "Index %lu is out of the vector\n", indices[q]);
+			return WRONG_VALUE;
+		}
+		frequencies[q] = reverse_bits(indices[q], number_of_qubits);
+		step_re[q] = cos(angle * frequencies[q]);
+		step_im[q] = sin(angle * frequencies[q]);
+	}
+	// суммы по запросам хранятся отдельно по вещественной и мнимой части, чтобы внутренний цикл векторизовался
+	std::vector<double> sums(2 * queries, 0.0);
+	const long blocks = (portion_size + QFT_AMPLITUDES_BLOCK - 1) / QFT_AMPLITUDES_BLOCK;
+	long b;
+	#pragma omp parallel
+	{
+		std::vector<double> acc_re(queries, 0.0), acc_im(queries, 0.0), w_re(queries), w_im(queries);
+		size_t k;
+		#pragma omp for
+		for(b = 0; b < blocks; b++)
+		{
+			const ulong start = b * QFT_AMPLITUDES_BLOCK;
+			const ulong end = std::min(start + QFT_AMPLITUDES_BLOCK, portion_size);
+			// произведение берется по модулю N: переполнение 64 бит младшие биты не портит
+			for(k = 0; k < queries; k++)
+			{
+				const ulong phase = ((first_index + start) * frequencies[k]) & (size_all - 1);
+				w_re[k] = cos(angle * phase);
+				w_im[k] = sin(angle * phase);
+			}
+			ulong j;
+			for(j = start; j < end; j++)
+			{
+				const double x_re = portion[j].real(), x_im = portion[j].imag();
+				for(k = 0; k < queries; k++)
+				{
+					acc_re[k] += x_re * w_re[k] - x_im * w_im[k];
+					acc_im[k] += x_re * w_im[k] + x_im * w_re[k];
+					const double next_re = w_re[k] * step_re[k] - w_im[k] * step_im[k];
+					w_im[k] = w_re[k] * step_im[k] + w_im[k] * step_re[k];
+					w_re[k] = next_re;
+				}
+			}
+		}
+		#pragma omp critical
+		for(k = 0; k < queries; k++)
+		{
+			sums[2 * k] += acc_re[k];
+			sums[2 * k + 1] += acc_im[k];
+		}
+	}
+	MPI_Allreduce(MPI_IN_PLACE, sums.data(), 2 * queries, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+	const double scale = 1.0 / sqrt(double(size_all));
+	amplitudes.resize(queries);
+	for(q = 0; q < queries; q++)
+		amplitudes[q] = complexd(sums[2 * q], sums[2 * q + 1]) * scale;
+	return SUCCESS;
+}
@@ -0,0 +1,400 @@
+#include "ooc.h"
+
+#include <future>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <errno.h>
+
+// Буферы прохода: три слота (читается, считается, пишется) по два блока и буфер обмена на полблока
+#define BLOCKED_BUFFERS 7
+
+file_storage::~file_storage()
+{
+	close(false);
+}
+
+int file_storage::open(const char *prefix, const ulong portion_size, const ulong _block_size)
+{
+	path = std::string(prefix) + "." + std::to_string(myrank);
+	block_size = _block_size;
+	fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0) {
+		fprintf(stderr, "Cannot open file %s\n", path.c_str());
+		return errno;
+	}
+	if(ftruncate(fd, portion_size * sizeof(complexd)) != 0) {
+		fprintf(stderr, "Cannot allocate %lu bytes in %s\n", portion_size * sizeof(complexd), path.c_str());
+		return errno;
+	}
+	return SUCCESS;
+}
+
+void file_storage::close(const bool remove_file)
+{
+	if(fd < 0)
+		return;
+	::close(fd);
+	fd = -1;
+	if(remove_file)
+		unlink(path.c_str());
+}
+
+int full_pread(const int fd, void *buffer, const size_t bytes, const off_t offset)
+{
+	size_t done = 0;
+	while(done < bytes)
+	{
+		ssize_t n = pread(fd, (char *)buffer + done, bytes - done, offset + done);
+		if(n <= 0)
+			return NOT_SUCCESS;
+		done += n;
+	}
+	return SUCCESS;
+}
+
+int full_pwrite(const int fd, const void *buffer, const size_t bytes, const off_t offset)
+{
+	size_t done = 0;
+	while(done < bytes)
+	{
+		ssize_t n = pwrite(fd, (const char *)buffer + done, bytes - done, offset + done);
+		if(n <= 0)
+			return NOT_SUCCESS;
+		done += n;
+	}
+	return SUCCESS;
+}
+
+int file_storage::load(const ulong block_num, complexd *buffer)
+{
+	const size_t bytes = block_size * sizeof(complexd);
+	return full_pread(fd, buffer, bytes, block_num * bytes);
+}
+
+int file_storage::store(const ulong block_num, const complexd *buffer)
+{
+	const size_t bytes = block_size * sizeof(complexd);
+	return full_pwrite(fd, buffer, bytes, block_num * bytes);
+}
+
+ulong blocked_block_size(const size_t number_of_qubits, const size_t memory_mb)
+{
+	ulong portion_size = (1UL << number_of_qubits) / proc_num;
+	ulong memory = ulong(memory_mb) << 20;
+	ulong block_size = 4;
+	while(block_size * 2 <= portion_size && block_size * 2 * BLOCKED_BUFFERS * sizeof(complexd) <= memory)
+		block_size *= 2;
+	return std::min(block_size, portion_size);
+}
+
+int blocked_init(blocked_state *state, const size_t number_of_qubits, block_storage *storage, const ulong block_size)
+{
+	ulong portion_size = (1UL << number_of_qubits) / proc_num;
+	if(number_of_qubits > BLOCKED_MAX_QUBITS || block_size < 4 || block_size > portion_size || (block_size & (block_size - 1)))
+	{
+		fprintf(stderr, "%s\n", "Wrong block size");
+		return WRONG_VALUE;
+	}
+	state->number_of_qubits = number_of_qubits;
+	state->portion_size = portion_size;
+	state->local_bits = log2_of(portion_size);
+	state->block_size = block_size;
+	state->block_bits = log2_of(block_size);
+	state->blocks_num = portion_size / block_size;
+	state->storage = storage;
+	state->passes = 0;
+	state->swaps = 0;
+	// локальные биты раскладки - биты внутри блока: туда переносятся целевые кубиты
+	layout_init(&state->layout, number_of_qubits, block_size);
+	int code = SUCCESS;
+	try
+	{
+		state->buffers = new complexd [BLOCKED_BUFFERS * block_size];
+	}
+	catch (std::bad_alloc& ba)
+	{
+		fprintf(stderr, "%s\n", "Failed to allocate block buffers");
+		state->buffers = NULL;
+		code = NO_MEMORY;
+	}
+	code = collective_code(code);
+	if(code != SUCCESS)
+		blocked_clean(state);
+	return code;
+}
+
+void blocked_clean(blocked_state *state)
+{
+	delete [] state->buffers;
+	state->buffers = NULL;
+}
+
+// Потоковый проход по хранилищу. Единица работы - unit_blocks блоков с номерами blocks_of(unit, j),
+// лежащих в буфере подряд. Пока считается единица u, единица u+1 читается, а u-1 пишется в фоне.
+// Коды каждой единицы сводятся по всем процессам: при ошибке на одном процессе проход прерывают все на той же
+// единице, и партнер не остается ждать в MPI_Sendrecv_replace
+template<class Blocks, class Compute>
+static int stream_pass(blocked_state *state, const ulong units, const int unit_blocks, Blocks blocks_of, Compute compute)
+{
+	const ulong unit_size = unit_blocks * state->block_size;
+	complexd *slot[3] = { state->buffers, state->buffers + unit_size, state->buffers + 2*unit_size };
+	block_storage *storage = state->storage;
+	const ulong block_size = state->block_size;
+	auto load_unit = [=](ulong u, complexd *buffer) -> int {
+		int j, code;
+		for(j = 0; j < unit_blocks; j++)
+			if((code = storage->load(blocks_of(u, j), buffer + j*block_size)) != SUCCESS)
+				return code;
+		return SUCCESS;
+	};
+	auto store_unit = [=](ulong u, complexd *buffer) -> int {
+		int j, code;
+		for(j = 0; j < unit_blocks; j++)
+			if((code = storage->store(blocks_of(u, j), buffer + j*block_size)) != SUCCESS)
+				return code;
+		return SUCCESS;
+	};
+	int code = SUCCESS;
+	std::future<int> reading = std::async(std::launch::async, load_unit, 0, slot[0]);
+	std::future<int> writing;
+	ulong u;
+	for(u = 0; u < units; u++)
+	{
+		complexd *current = slot[u % 3];
+		code = collective_code(reading.get());
+		if(code != SUCCESS)
+			break;
+		if(u + 1 < units)
+			reading = std::async(std::launch::async, load_unit, u + 1, slot[(u + 1) % 3]);
+		code = compute(u, current);
+		// слот u-1 освободится, когда допишется; только после этого в него можно читать u+2
+		if(code == SUCCESS && writing.valid())
+			code = writing.get();
+		code = collective_code(code);
+		if(code != SUCCESS)
+			break;
+		writing = std::async(std::launch::async, store_unit, u, current);
+	}
+	if(reading.valid())
+		reading.wait();
+	if(writing.valid()) {
+		int write_code = writing.get();
+		if(code == SUCCESS)
+			code = write_code;
+	}
+	code = collective_code(code);
+	if(code != SUCCESS)
+		fprintf(stderr, "%s\n", "Out-of-core pass failed");
+	state->passes++;
+	return code;
+}
+
+// Меняет местами физические биты a и b (a внутри блока)
+static int swap_bits_in_block(blocked_state *state, const int a, const int b)
+{
+	int code;
+	const ulong block_size = state->block_size;
+	const ulong amask = 1UL << a;
+	if(b < (int)state->block_bits)
+	{
+		gate g = make_gate2(GATE_SWAP, 1, 2);
+		ulong masks[GATE_MAX_QUBITS] = { amask, 1UL << b, 0 };
+		const ulong first_index = myrank * state->portion_size;
+		code = stream_pass(state, state->blocks_num, 1,
+			[](ulong u, int) { return u; },
+			[&](ulong u, complexd *buffer) { return apply_gate_block(buffer, block_size, first_index + u*block_size, g, masks); });
+	}
+	else if(b < (int)state->local_bits)
+	{
+		// пара блоков, отличающихся битом b: элементы первого с единицей в a меняются с элементами второго с нулем в a
+		const ulong stride = 1UL << (b - state->block_bits);
+		code = stream_pass(state, state->blocks_num / 2, 2,
+			[=](ulong u, int j) { return insert_zero(u, stride) | (j ? stride : 0); },
+			[=](ulong, complexd *buffer) {
+				long i;
+				const long pairs = block_size / 2;
+				#pragma omp parallel for
+				for(i = 0; i < pairs; i++) {
+					ulong index = insert_zero(i, amask) | amask;
+					std::swap(buffer[index], buffer[block_size + (index ^ amask)]);
+				}
+				return SUCCESS;
+			});
+	}
+	else
+	{
+		// бит b - номер процесса: как в transform, меняемся с партнером половиной каждого блока
+		const int rank_bit = 1 << (b - state->local_bits);
+		const int partner = myrank ^ rank_bit;
+		const ulong my_value = (myrank & rank_bit) ? amask : 0;
+		complexd *exchange = state->buffers + 6*block_size;
+		code = stream_pass(state, state->blocks_num, 1,
+			[](ulong u, int) { return u; },
+			[=](ulong, complexd *buffer) {
+				long i;
+				const long pairs = block_size / 2;
+				// отправляем элементы, у которых бит a не совпадает с битом процесса
+				#pragma omp parallel for
+				for(i = 0; i < pairs; i++)
+					exchange[i] = buffer[insert_zero(i, amask) | (my_value ^ amask)];
+				MPI_Status status;
+				int code = MPI_Sendrecv_replace(exchange, pairs, MPI_DOUBLE_COMPLEX, partner, NO_TAG, partner, NO_TAG, MPI_COMM_WORLD, &status);
+				#pragma omp parallel for
+				for(i = 0; i < pairs; i++)
+					buffer[insert_zero(i, amask) | (my_value ^ amask)] = exchange[i];
+				return code == MPI_SUCCESS ? SUCCESS : code;
+			});
+	}
+	if(code == SUCCESS) {
+		layout_swap(&state->layout, a, b);
+		state->swaps++;
+	}
+	return code;
+}
+
+static int swap_bits(blocked_state *state, int a, int b)
+{
+	if(a > b)
+		std::swap(a, b);
+	if(a < (int)state->block_bits)
+		return swap_bits_in_block(state, a, b);
+	// оба бита вне блока: (a b) = (v a)(v b)(v a) для любого бита v внутри блока
+	int code = swap_bits_in_block(state, 0, a);
+	if(code == SUCCESS)
+		code = swap_bits_in_block(state, 0, b);
+	if(code == SUCCESS)
+		code = swap_bits_in_block(state, 0, a);
+	return code;
+}
+
+int blocked_apply_circuit(blocked_state *state, const gate *gates, const size_t count)
+{
+	const ulong block_size = state->block_size;
+	const ulong first_index = myrank * state->portion_size;
+	size_t i = 0;
+	int code;
+	while(i < count)
+	{
+		if(gates[i].type == GATE_MEASURE)
+		{
+			fprintf(stderr, "%s\n", "Measurement is not supported out of core");
+			return WRONG_VALUE;
+		}
+		// переносим целевые биты вентиля внутрь блока
+		ulong targets = layout_target_mask(&state->layout, gates[i]);
+		while(targets >= block_size)
+		{
+			int bit = log2_of(targets);
+			int victim = layout_victim(&state->layout, gates + i + 1, count - i - 1, targets);
+			if(victim < 0)
+			{
+				fprintf(stderr, "%s\n", "Block is too small for the gate");
+				return WRONG_VALUE;
+			}
+			code = swap_bits(state, victim, bit);
+			if(code != SUCCESS)
+				return code;
+			targets = layout_target_mask(&state->layout, gates[i]);
+		}
+		// группа: подряд идущие вентили, не требующие перестановок
+		size_t group_end = i + 1;
+		while(group_end < count && gates[group_end].type != GATE_MEASURE && layout_target_mask(&state->layout, gates[group_end]) < block_size)
+			group_end++;
+		const gate *group = gates + i;
+		const size_t group_size = group_end - i;
+		const size_t number_of_qubits = state->number_of_qubits;
+		const int *bit_of = state->layout.bit_of;
+		code = stream_pass(state, state->blocks_num, 1,
+			[](ulong u, int) { return u; },
+			[=](ulong u, complexd *buffer) {
+				size_t k;
+				ulong masks[GATE_MAX_QUBITS];
+				for(k = 0; k < group_size; k++) {
+					gate_masks(group[k], number_of_qubits, bit_of, masks);
+					int code = apply_gate_block(buffer, block_size, first_index + u*block_size, group[k], masks);
+					if(code != SUCCESS)
+						return code;
+				}
+				return SUCCESS;
+			});
+		if(code != SUCCESS)
+			return code;
+		i = group_end;
+	}
+	return SUCCESS;
+}
+
+int blocked_restore_layout(blocked_state *state)
+{
+	int bit, code;
+	for(bit = 0; bit < (int)state->number_of_qubits; bit++)
+	{
+		int q = state->number_of_qubits - bit;
+		if(state->layout.bit_of[q] != bit && (code = swap_bits(state, bit, state->layout.bit_of[q])) != SUCCESS)
+			return code;
+	}
+	return SUCCESS;
+}
+
+int blocked_read_vector_from_file(blocked_state *state, const char *filename)
+{
+	int code = SUCCESS;
+	int fd = open(filename, O_RDONLY);
+	if(fd < 0) {
+		fprintf(stderr, "Cannot open file %s\n", filename);
+		code = errno;
+	}
+	const size_t bytes = state->block_size * sizeof(complexd);
+	const off_t offset = myrank * state->portion_size * sizeof(complexd);
+	ulong k;
+	for(k = 0; k < state->blocks_num && code == SUCCESS; k++)
+	{
+		code = full_pread(fd, state->buffers, bytes, offset + k*bytes);
+		if(code == SUCCESS)
+			code = state->storage->store(k, state->buffers);
+		if(code != SUCCESS)
+			fprintf(stderr, "Error when reading file %s\n", filename);
+	}
+	if(fd >= 0)
+		close(fd);
+	return collective_code(code);
+}
+
+int blocked_write_vector_to_file(blocked_state *state, const char *filename)
+{
+	// в файл вектор пишется в исходном порядке кубитов
+	int code = blocked_restore_layout(state);
+	if(code != SUCCESS)
+		return code;
+	// рутовый процесс создает и обрезает файл, затем каждый процесс пишет в него свою часть
+	int fd = -1;
+	if(i_am_the_master)
+	{
+		fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if(fd < 0)
+			code = errno;
+		else
+			close(fd);
+	}
+	MPI_Bcast(&code, 1, MPI_INT, MASTER, MPI_COMM_WORLD);
+	if(code == SUCCESS && (fd = open(filename, O_WRONLY)) < 0)
+		code = errno;
+	if(code != SUCCESS)
+		fprintf(stderr, "Error when opening file %s\n", filename);
+	const size_t bytes = state->block_size * sizeof(complexd);
+	const off_t offset = myrank * state->portion_size * sizeof(complexd);
+	ulong k;
+	for(k = 0; k < state->blocks_num && code == SUCCESS; k++)
+	{
+		code = state->storage->load(k, state->buffers);
+		if(code == SUCCESS)
+			code = full_pwrite(fd, state->buffers, bytes, offset + k*bytes);
+		if(code != SUCCESS)
+			fprintf(stderr, "Error when writing to file %s\n", filename);
+	}
+	if(fd >= 0)
+		close(fd);
+	return collective_code(code);
+}
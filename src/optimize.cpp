@@ -0,0 +1,246 @@
+#include "optimize.h"
+
+#include <cmath>
+
+#define ANGLE_EPS 1e-12
+#define OPTIMIZE_MAX_PASSES 16
+
+static const double pi = std::acos(-1);
+
+void estimate_cost(const gate *gates, const size_t count, const size_t number_of_qubits, const int processes, circuit_cost *cost)
+{
+	cost->gates += count;
+	dense_circuit_cost(gates, count, number_of_qubits, processes, &cost->sweeps, &cost->exchanges);
+}
+
+void optimize_report_init(optimize_report *report)
+{
+	report->before.gates = report->before.sweeps = report->before.exchanges = 0;
+	report->after = report->before;
+}
+
+// Поворот на angle тождественен, если angle кратен period
+static bool is_identity_angle(const double angle, const double period)
+{
+	return std::fabs(std::remainder(angle, period)) < ANGLE_EPS;
+}
+
+static bool has_qubit(const gate &g, const size_t q)
+{
+	size_t k;
+	for(k = 0; k < g.qubits_num; k++)
+		if(g.qubits[k] == q)
+			return true;
+	return false;
+}
+
+static bool same_qubit_set(const gate &a, const gate &b)
+{
+	if(a.qubits_num != b.qubits_num)
+		return false;
+	size_t k;
+	for(k = 0; k < a.qubits_num; k++)
+		if(!has_qubit(b, a.qubits[k]))
+			return false;
+	return true;
+}
+
+// Вентиль b, идущий сразу после a на тех же кубитах, отменяет его
+static bool cancels(const gate &a, const gate &b)
+{
+	if(a.type != b.type)
+		return false;
+	switch(a.type)
+	{
+		case GATE_H:
+		case GATE_X:
+		case GATE_SWAP:
+			return true;
+		case GATE_CX:
+			return a.qubits[0] == b.qubits[0];
+		case GATE_CCX:
+			return a.qubits[2] == b.qubits[2];
+		default:
+			return false;
+	}
+}
+
+// Вентили, уже просмотренные проходом, по кубитам
+struct wire_map
+{
+	std::vector< std::vector<size_t> > wires;	// wires[q] - номера вентилей на кубите q по порядку
+	std::vector<char> removed;
+};
+
+// depth-й с конца неудаленный вентиль на кубите q, -1 если его нет
+static long wire_back(wire_map *w, const size_t q, size_t depth)
+{
+	std::vector<size_t> &wire = w->wires[q];
+	while(!wire.empty() && w->removed[wire.back()])
+		wire.pop_back();
+	size_t k;
+	for(k = wire.size(); k > 0; k--)
+	{
+		if(w->removed[wire[k-1]])
+			continue;
+		if(depth == 0)
+			return wire[k-1];
+		depth--;
+	}
+	return -1;
+}
+
+// Предыдущий вентиль, общий для всех кубитов g, -1 если его нет
+static long common_previous(wire_map *w, const gate &g)
+{
+	long j = wire_back(w, g.qubits[0], 0);
+	size_t k;
+	for(k = 1; k < g.qubits_num; k++)
+		if(wire_back(w, g.qubits[k], 0) != j)
+			return -1;
+	return j;
+}
+
+// От конца кубита q до вентиля j только вентили, диагональные на q
+static bool reachable_diagonally(const wire_map *w, const std::vector<gate> &gates, const size_t q, const size_t j)
+{
+	const std::vector<size_t> &wire = w->wires[q];
+	size_t k;
+	for(k = wire.size(); k > 0; k--)
+	{
+		size_t i = wire[k-1];
+		if(w->removed[i])
+			continue;
+		if(i == j)
+			return true;
+		if(!gate_is_diagonal_on(gates[i], q))
+			return false;
+	}
+	return false;
+}
+
+// Диагональный вентиль g складывается с таким же вентилем, до которого его можно перенести. true - g поглощен
+static bool merge_diagonal(wire_map *w, std::vector<gate> &gates, const gate &g)
+{
+	const size_t q = g.qubits[0];
+	const std::vector<size_t> &wire = w->wires[q];
+	size_t k, m;
+	for(k = wire.size(); k > 0; k--)
+	{
+		const size_t j = wire[k-1];
+		if(w->removed[j])
+			continue;
+		gate &prev = gates[j];
+		if(!gate_is_diagonal_on(prev, q))
+			return false;
+		if(prev.type != g.type || !same_qubit_set(prev, g))
+			continue;
+		// на остальных кубитах путь до prev тоже должен быть диагональным; если он закрыт, более ранние тоже недоступны
+		for(m = 1; m < g.qubits_num; m++)
+			if(!reachable_diagonally(w, gates, g.qubits[m], j))
+				return false;
+		switch(g.type)
+		{
+			case GATE_Z:
+				w->removed[j] = 1;
+				break;
+			case GATE_RZ:
+				prev.param += g.param;
+				w->removed[j] = is_identity_angle(prev.param, 4*pi);
+				break;
+			case GATE_CP:
+				prev.param += g.param;
+				w->removed[j] = is_identity_angle(prev.param, 2*pi);
+				break;
+		}
+		return true;
+	}
+	return false;
+}
+
+// H X H = Z, H Z H = X, X RZ(a) X = RZ(-a): крайние вентили поглощаются. true - g поглощен
+static bool absorb_conjugation(wire_map *w, std::vector<gate> &gates, const gate &g)
+{
+	if(g.type != GATE_H && g.type != GATE_X)
+		return false;
+	const size_t q = g.qubits[0];
+	long k = wire_back(w, q, 0), j = wire_back(w, q, 1);
+	if(k < 0 || j < 0 || gates[k].qubits_num != 1 || gates[j].qubits_num != 1 || gates[j].type != g.type)
+		return false;
+	if(g.type == GATE_H && (gates[k].type == GATE_X || gates[k].type == GATE_Z))
+	{
+		gates[j].type = gates[k].type == GATE_X ? GATE_Z : GATE_X;
+		w->removed[k] = 1;
+		return true;
+	}
+	if(g.type == GATE_X && gates[k].type == GATE_RZ)
+	{
+		gates[k].param = -gates[k].param;
+		w->removed[j] = 1;
+		return true;
+	}
+	return false;
+}
+
+// Один проход по схеме. false - ничего не изменилось
+static bool optimize_pass(std::vector<gate> &gates, const size_t number_of_qubits)
+{
+	wire_map w;
+	w.wires.resize(number_of_qubits + 1);
+	w.removed.assign(gates.size(), 0);
+	bool changed = false;
+	size_t i, k;
+	for(i = 0; i < gates.size(); i++)
+	{
+		const gate g = gates[i];
+		bool absorbed = false;
+		if(g.type != GATE_MEASURE)
+		{
+			long j = common_previous(&w, g);
+			if(j >= 0 && same_qubit_set(gates[j], g))
+			{
+				if(cancels(gates[j], g))
+				{
+					w.removed[j] = 1;
+					absorbed = true;
+				}
+				else if(g.type == GATE_RX && gates[j].type == GATE_RX)
+				{
+					gates[j].param += g.param;
+					w.removed[j] = is_identity_angle(gates[j].param, 4*pi);
+					absorbed = true;
+				}
+			}
+			if(!absorbed && gate_is_diagonal(g))
+				absorbed = merge_diagonal(&w, gates, g);
+			if(!absorbed)
+				absorbed = absorb_conjugation(&w, gates, g);
+		}
+		if(absorbed)
+		{
+			w.removed[i] = 1;
+			changed = true;
+			continue;
+		}
+		for(k = 0; k < g.qubits_num; k++)
+			w.wires[g.qubits[k]].push_back(i);
+	}
+	size_t kept = 0;
+	for(i = 0; i < gates.size(); i++)
+		if(!w.removed[i])
+			gates[kept++] = gates[i];
+	gates.resize(kept);
+	return changed;
+}
+
+void optimize_circuit(std::vector<gate> &gates, const size_t number_of_qubits, optimize_report *report)
+{
+	if(report != NULL)
+		estimate_cost(gates.data(), gates.size(), number_of_qubits, proc_num, &report->before);
+	// поглощение создает новые соседние пары, поэтому повторяем
+	int pass;
+	for(pass = 0; pass < OPTIMIZE_MAX_PASSES && optimize_pass(gates, number_of_qubits); pass++)
+		;
+	if(report != NULL)
+		estimate_cost(gates.data(), gates.size(), number_of_qubits, proc_num, &report->after);
+}
@@ -0,0 +1,178 @@
+#include "permutation.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <stdio.h>
+
+// Перестановка внутри части: каждый цикл проходится один раз, амплитуда переносится на следующее место цикла
+static void permute_in_place(complexd *portion, const ulong portion_size, const ulong first, permutation_function f, void *arg)
+{
+	std::vector<bool> visited(portion_size, false);
+	ulong start;
+	for(start = 0; start < portion_size; start++)
+	{
+		if(visited[start])
+			continue;
+		complexd carried = portion[start];
+		ulong current = start;
+		do
+		{
+			visited[current] = true;
+			const ulong next = f(first + current, arg) - first;
+			std::swap(carried, portion[next]);
+			current = next;
+		} while(current != start);
+	}
+}
+
+// Пара для рассылки: индекс назначения и амплитуда
+struct permutation_entry
+{
+	ulong index;
+	complexd value;
+};
+
+static int permute_out_of_place(complexd *portion, const ulong portion_size, const ulong first, permutation_function f, void *arg,
+	const std::vector<ulong> &counts)
+{
+	complexd *target = new (std::nothrow) complexd [portion_size];
+	int failed = target == NULL;
+	MPI_Allreduce(MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+	if(failed) {
+		delete [] target;
+		fprintf(stderr, "%s\n", "Failed to allocate memory for the permuted portion");
+		return NO_MEMORY;
+	}
+	std::vector<int> send_counts(proc_num), recv_counts(proc_num), send_displs(proc_num), recv_displs(proc_num);
+	int p, total = 0;
+	for(p = 0; p < proc_num; p++)
+	{
+		send_counts[p] = p == myrank ? 0 : counts[p];
+		send_displs[p] = total;
+		total += send_counts[p];
+	}
+	std::vector<permutation_entry> send_buffer(total);
+	std::vector<int> filled(send_displs);
+	ulong i;
+	for(i = 0; i < portion_size; i++)
+	{
+		const ulong destination = f(first + i, arg);
+		const int owner = destination / portion_size;
+		if(owner == myrank)
+			target[destination - first] = portion[i];
+		else {
+			permutation_entry &entry = send_buffer[filled[owner]++];
+			entry.index = destination;
+			entry.value = portion[i];
+		}
+	}
+	MPI_Datatype entry_type;
+	MPI_Type_contiguous(sizeof(permutation_entry), MPI_BYTE, &entry_type);
+	MPI_Type_commit(&entry_type);
+	int code = MPI_Alltoall(send_counts.data(), 1, MPI_INT, recv_counts.data(), 1, MPI_INT, MPI_COMM_WORLD);
+	total = 0;
+	for(p = 0; p < proc_num; p++)
+	{
+		recv_displs[p] = total;
+		total += recv_counts[p];
+	}
+	std::vector<permutation_entry> incoming(total);
+	if(code == MPI_SUCCESS)
+		code = MPI_Alltoallv(send_buffer.data(), send_counts.data(), send_displs.data(), entry_type,
+		                     incoming.data(), recv_counts.data(), recv_displs.data(), entry_type, MPI_COMM_WORLD);
+	MPI_Type_free(&entry_type);
+	if(code == MPI_SUCCESS)
+	{
+		long k;
+		const long received = incoming.size();
+		#pragma omp parallel for
+		for(k = 0; k < received; k++)
+			target[incoming[k].index - first] = incoming[k].value;
+		memcpy(portion, target, portion_size * sizeof(complexd));
+	}
+	delete [] target;
+	return code == MPI_SUCCESS ? SUCCESS : code;
+}
+
+int apply_permutation(complexd *portion, const size_t number_of_qubits, permutation_function f, void *arg)
+{
+	const ulong portion_size = (1UL << number_of_qubits) / proc_num;
+	const ulong first = myrank * portion_size;
+	// сколько амплитуд уходит каждому процессу
+	std::vector<ulong> counts(proc_num, 0);
+	long i;
+	const long size = portion_size;
+	#pragma omp parallel
+	{
+		std::vector<ulong> local(proc_num, 0);
+		#pragma omp for
+		for(i = 0; i < size; i++)
+			local[f(first + i, arg) / portion_size]++;
+		#pragma omp critical
+		{
+			int p;
+			for(p = 0; p < proc_num; p++)
+				counts[p] += local[p];
+		}
+	}
+	int leaving = counts[myrank] != portion_size;
+	MPI_Allreduce(MPI_IN_PLACE, &leaving, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+	if(!leaving) {
+		permute_in_place(portion, portion_size, first, f, arg);
+		return SUCCESS;
+	}
+	return permute_out_of_place(portion, portion_size, first, f, arg, counts);
+}
+
+static ulong multiply_mod(const ulong a, const ulong b, const ulong modulus)
+{
+	return ulong((unsigned __int128)a * b % modulus);
+}
+
+int modexp_oracle_init(modexp_oracle *oracle, const size_t number_of_qubits, const ulong a, const ulong modulus, const size_t x_qubits)
+{
+	ulong gcd = a, other = modulus;
+	while(other != 0) {
+		const ulong rest = gcd % other;
+		gcd = other;
+		other = rest;
+	}
+	if(x_qubits == 0 || x_qubits >= number_of_qubits || modulus < 2 || modulus > (1UL << (number_of_qubits - x_qubits)) || gcd != 1)
+	{
+		if(i_am_the_master)
+			fprintf(stderr, "%s\n", "Modular exponentiation needs gcd(a, N) = 1 and N <= 2^(number_of_qubits - x_qubits)");
+		return WRONG_VALUE;
+	}
+	oracle->y_bits = number_of_qubits - x_qubits;
+	oracle->modulus = modulus;
+	oracle->powers.assign(x_qubits, 0);
+	ulong power = a % modulus;
+	size_t k;
+	for(k = 0; k < x_qubits; k++)
+	{
+		oracle->powers[k] = power;
+		power = multiply_mod(power, power, modulus);
+	}
+	return SUCCESS;
+}
+
+ulong modexp_permutation(const ulong index, void *arg)
+{
+	const modexp_oracle *oracle = (const modexp_oracle *)arg;
+	const ulong x = index >> oracle->y_bits, y = index & ((1UL << oracle->y_bits) - 1);
+	if(y >= oracle->modulus)
+		return index;
+	ulong result = y;
+	size_t k;
+	for(k = 0; k < oracle->powers.size(); k++)
+		if((x >> k) & 1)
+			result = multiply_mod(result, oracle->powers[k], oracle->modulus);
+	return (x << oracle->y_bits) | result;
+}
+
+ulong add_permutation(const ulong index, void *arg)
+{
+	const ulong *shift_and_mask = (const ulong *)arg;
+	return (index + shift_and_mask[0]) & shift_and_mask[1];
+}
@@ -0,0 +1,151 @@
+#include "functions.h"
+#include "batch.h"
+#include "gates.h"
+
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <stdlib.h>
+
+int myrank, proc_num, i_am_the_master;
+
+void usage()
+{
+	printf("Usage: pipeline <number_of_qubits> [--input <file>] [--dump <prefix>]\n");
+	printf("  generate (or read <file>) -> solve -> fidelity in one run, states stay in memory\n");
+	printf("  --dump <prefix>   also write <prefix>input, <prefix>output and <prefix>reference\n");
+}
+
+// Стадии make test в одном запуске: QFT считается исполнителем схем, как в solve --circuit,
+// и сверяется с qft_transform
+struct pipeline_times
+{
+	double generate;
+	double solve;
+	double reference;
+	double fidelity;
+	double dump;
+};
+
+static double stage_start()
+{
+	MPI_Barrier(MPI_COMM_WORLD);
+	return MPI_Wtime();
+}
+
+static double stage_time(const double start)
+{
+	MPI_Barrier(MPI_COMM_WORLD);
+	return MPI_Wtime() - start;
+}
+
+// Каждый процесс сам пишет свою часть
+static int dump(const complexd *portion, const size_t number_of_qubits, const std::string &filename, double *time)
+{
+	double start = stage_start();
+	int code = batch_write_vectors(portion, number_of_qubits, std::vector<std::string>(1, filename));
+	*time += stage_time(start);
+	return code;
+}
+
+int run_pipeline(const size_t number_of_qubits, const char *input_file, const char *dump_prefix)
+{
+	pipeline_times times;
+	memset(&times, 0, sizeof(times));
+	complexd *portion = NULL;
+	int code = mymalloc(&portion, number_of_qubits);
+	if(code != SUCCESS)
+		return code;
+	double start = stage_start();
+	if(input_file != NULL)
+		code = batch_read_vectors(portion, number_of_qubits, std::vector<std::string>(1, input_file));
+	else
+		code = generate_state(portion, number_of_qubits);
+	times.generate = stage_time(start);
+	const std::string prefix(dump_prefix != NULL ? dump_prefix : "");
+	if(code == SUCCESS && dump_prefix != NULL)
+		code = dump(portion, number_of_qubits, prefix + "input", &times.dump);
+	complexd *portion_copy = NULL;
+	if(code == SUCCESS)
+	{
+		portion_copy = copy_state(portion, number_of_qubits);
+		if(portion_copy == NULL)
+			code = NO_MEMORY;
+		else
+			// нулевые куски (например, у базисного состояния) qft_transform не обрабатывает;
+			// исполнитель схем карту не ведет, поэтому у portion ее нет
+			zero_tracking_attach(portion_copy, number_of_qubits);
+	}
+	if(code == SUCCESS)
+	{
+		std::vector<gate> gates;
+		qft_circuit(number_of_qubits, gates);
+		start = stage_start();
+		code = apply_circuit_dense(portion, number_of_qubits, gates.data(), gates.size());
+		times.solve = stage_time(start);
+	}
+	if(code == SUCCESS)
+	{
+		start = stage_start();
+		code = qft_transform(portion_copy, number_of_qubits);
+		times.reference = stage_time(start);
+	}
+	if(code == SUCCESS && dump_prefix != NULL)
+	{
+		code = dump(portion, number_of_qubits, prefix + "output", &times.dump);
+		if(code == SUCCESS)
+			code = dump(portion_copy, number_of_qubits, prefix + "reference", &times.dump);
+	}
+	if(code == SUCCESS)
+	{
+		start = stage_start();
+		double fid = fidelity(portion, portion_copy, number_of_qubits);
+		times.fidelity = stage_time(start);
+		if(i_am_the_master)
+		{
+			printf("Fidelity: %d%%\n", int(floor(fid*100)));
+			printf("Stages for %zu qubits on %d processes, s: %s %.3lf, solve %.3lf, reference %.3lf, fidelity %.3lf",
+				number_of_qubits, proc_num, input_file != NULL ? "read" : "generate", times.generate, times.solve,
+				times.reference, times.fidelity);
+			if(dump_prefix != NULL)
+				printf(", dumps %.3lf", times.dump);
+			printf("\n");
+		}
+	}
+	if(portion_copy != NULL)
+		myfree(portion_copy);
+	myfree(portion);
+	return code;
+}
+
+int main(int argc, char **argv)
+{
+	MPI_Init (&argc, &argv);
+    MPI_Comm_rank (MPI_COMM_WORLD, &myrank);
+    MPI_Comm_size (MPI_COMM_WORLD, &proc_num);
+    i_am_the_master = myrank == MASTER;
+	const char *input_file = NULL, *dump_prefix = NULL;
+	bool parsed = argc >= 2 && atoi(argv[1]) > 0;
+	int k;
+	for(k = 2; parsed && k < argc; k += 2)
+	{
+		if(k + 1 < argc && strcmp(argv[k], "--input") == 0)
+			input_file = argv[k + 1];
+		else if(k + 1 < argc && strcmp(argv[k], "--dump") == 0)
+			dump_prefix = argv[k + 1];
+		else
+			parsed = false;
+	}
+	if(!parsed) {
+		if(i_am_the_master)
+			usage();
+	}
+	else {
+		// инициализация библиотеки
+	    functions_init(myrank, proc_num, i_am_the_master);
+		run_pipeline(atoi(argv[1]), input_file, dump_prefix);
+		functions_clean();
+	}
+	MPI_Finalize();
+	return SUCCESS;
+}
@@ -0,0 +1,187 @@
+#include "qaoa.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <stdio.h>
+
+// Наибольший размер таблицы стоимостей части вектора
+#define QAOA_TABLE_BYTES (1UL << 28)
+
+int read_graph(const char *filename, const size_t number_of_qubits, qaoa_graph *graph)
+{
+	std::ifstream in(filename);
+	if(!in) {
+		if(i_am_the_master)
+			fprintf(stderr, "Cannot open file %s\n", filename);
+		return NOT_SUCCESS;
+	}
+	graph->edges.clear();
+	graph->integral = true;
+	graph->total_weight = 0;
+	std::string line;
+	size_t line_number = 0;
+	while(std::getline(in, line))
+	{
+		line_number++;
+		line = line.substr(0, line.find('#'));
+		std::istringstream fields(line);
+		long u, v;
+		if(!(fields >> u))
+			continue;
+		qaoa_edge edge;
+		edge.weight = 1;
+		if(!(fields >> v) || u < 1 || v < 1 || size_t(u) > number_of_qubits || size_t(v) > number_of_qubits || u == v
+			|| (!(fields >> edge.weight) && !fields.eof())) {
+			if(i_am_the_master)
+				fprintf(stderr, "Wrong edge in %s, line %zu\n", filename, line_number);
+			return WRONG_VALUE;
+		}
+		edge.u = u;
+		edge.v = v;
+		graph->edges.push_back(edge);
+		graph->integral = graph->integral && edge.weight >= 0 && edge.weight == floor(edge.weight);
+		graph->total_weight += edge.weight;
+	}
+	return SUCCESS;
+}
+
+// Сдвиги битов вершин ребер
+struct edge_shifts
+{
+	unsigned char u;
+	unsigned char v;
+};
+
+static inline double cut_value(const ulong index, const edge_shifts *shifts, const double *weights, const size_t edges)
+{
+	double cost = 0;
+	size_t e;
+	for(e = 0; e < edges; e++)
+		cost += weights[e] * double(((index >> shifts[e].u) ^ (index >> shifts[e].v)) & 1);
+	return cost;
+}
+
+struct cost_function
+{
+	std::vector<edge_shifts> shifts;
+	std::vector<double> weights;
+	std::vector<double> table;	// пустая - C считается на лету
+	ulong first;
+};
+
+static void cost_init(cost_function *cost, const size_t number_of_qubits, const qaoa_graph *graph, const ulong portion_size)
+{
+	size_t e;
+	for(e = 0; e < graph->edges.size(); e++)
+	{
+		edge_shifts shifts = { (unsigned char)(number_of_qubits - graph->edges[e].u), (unsigned char)(number_of_qubits - graph->edges[e].v) };
+		cost->shifts.push_back(shifts);
+		cost->weights.push_back(graph->edges[e].weight);
+	}
+	cost->first = myrank * portion_size;
+	if(portion_size * sizeof(double) <= QAOA_TABLE_BYTES)
+	{
+		cost->table.resize(portion_size);
+		long i;
+		const long size = portion_size;
+		#pragma omp parallel for
+		for(i = 0; i < size; i++)
+			cost->table[i] = cut_value(cost->first + i, cost->shifts.data(), cost->weights.data(), cost->shifts.size());
+	}
+}
+
+static inline double cost_at(const cost_function *cost, const ulong i)
+{
+	return cost->table.empty() ? cut_value(cost->first + i, cost->shifts.data(), cost->weights.data(), cost->shifts.size()) : cost->table[i];
+}
+
+// exp(-i*gamma*C) без обменов
+static void cost_layer(complexd *portion, const ulong portion_size, const cost_function *cost, const qaoa_graph *graph, const double gamma)
+{
+	long i;
+	const long size = portion_size;
+	// таблица не больше части: при больших весах ее заполнение дороже прохода
+	if(graph->integral && graph->total_weight < portion_size)
+	{
+		// C целое: фаза из таблицы на total_weight + 1 значений
+		std::vector<complexd> phases(size_t(graph->total_weight) + 1);
+		size_t c;
+		for(c = 0; c < phases.size(); c++)
+			phases[c] = std::polar(1.0, -gamma * c);
+		#pragma omp parallel for
+		for(i = 0; i < size; i++)
+			portion[i] *= phases[size_t(cost_at(cost, i))];
+	}
+	else
+	{
+		#pragma omp parallel for
+		for(i = 0; i < size; i++)
+			portion[i] *= std::polar(1.0, -gamma * cost_at(cost, i));
+	}
+}
+
+int qaoa_run(complexd *portion, const size_t number_of_qubits, const qaoa_graph *graph, const std::vector<double> &gammas,
+	const std::vector<double> &betas, qaoa_result *result)
+{
+	const ulong portion_size = (1UL << number_of_qubits) / proc_num;
+	cost_function cost;
+	cost_init(&cost, number_of_qubits, graph, portion_size);
+	std::vector<gate> mixer;
+	int code = SUCCESS;
+	size_t layer, q;
+	for(layer = 0; layer < gammas.size() && code == SUCCESS; layer++)
+	{
+		cost_layer(portion, portion_size, &cost, graph, gammas[layer]);
+		mixer.clear();
+		for(q = 1; q <= number_of_qubits; q++)
+			mixer.push_back(make_gate1(GATE_RX, q, 2 * betas[layer]));
+		code = apply_circuit_dense(portion, number_of_qubits, mixer.data(), mixer.size());
+	}
+	if(code != SUCCESS)
+		return code;
+	// заключительный проход: <C>, наибольший разрез части и вероятность его получить
+	double expectation = 0;
+	struct
+	{
+		double value;
+		double probability;
+	} best = { -1, 0 };
+	long i;
+	const long size = portion_size;
+	#pragma omp parallel
+	{
+		double local_expectation = 0, local_max = -1, local_probability = 0;
+		#pragma omp for
+		for(i = 0; i < size; i++)
+		{
+			const double c = cost_at(&cost, i), p = std::norm(portion[i]);
+			local_expectation += c * p;
+			if(c > local_max) {
+				local_max = c;
+				local_probability = 0;
+			}
+			if(c == local_max)
+				local_probability += p;
+		}
+		#pragma omp critical
+		{
+			expectation += local_expectation;
+			if(local_max > best.value) {
+				best.value = local_max;
+				best.probability = 0;
+			}
+			if(local_max == best.value)
+				best.probability += local_probability;
+		}
+	}
+	MPI_Allreduce(MPI_IN_PLACE, &expectation, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+	result->expectation = expectation;
+	MPI_Allreduce(&best.value, &result->max_cut, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+	if(best.value != result->max_cut)
+		best.probability = 0;
+	MPI_Allreduce(&best.probability, &result->max_cut_probability, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+	return SUCCESS;
+}
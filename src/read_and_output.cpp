@@ -1,11 +1,24 @@
 #include "functions.h"
+#include "manifest.h"
+#include "shm.h"
 #include <stdlib.h>
+#include <cstring>
 
 int myrank, proc_num, i_am_the_master;
 
 void usage()
 {
-	printf("Usage: view <input_file> <number_of_qubits>");
+	printf("Usage: view <input_file> <number_of_qubits>\n");
+	printf("       view --manifest <file>    lines \"<input_file> <number_of_qubits>\"\n");
+	printf("       view --shm <name>         vector left in shared memory by solve --shm\n");
+}
+
+int view_job(const manifest_job &job, complexd **vectors, void *)
+{
+	if(i_am_the_master)
+		printf("%s:\n", job.files[0].c_str());
+	output_vector(vectors[0], job.number_of_qubits);
+	return SUCCESS;
 }
 
 int main(int argc, char **argv)
@@ -18,6 +31,25 @@ int main(int argc, char **argv)
 		if(i_am_the_master)
 			usage();
 	}
+	else if(strcmp(argv[1], "--shm") == 0) {
+		functions_init(myrank, proc_num, i_am_the_master);
+		// амплитуды читаются прямо из разделяемой памяти
+		shm_portion mapping;
+		size_t number_of_qubits = 0;
+		if(shm_attach(argv[2], &number_of_qubits, &mapping) == SUCCESS)
+		{
+			output_vector(mapping.portion, number_of_qubits);
+			shm_detach(&mapping);
+		}
+		functions_clean();
+	}
+	else if(strcmp(argv[1], "--manifest") == 0) {
+		functions_init(myrank, proc_num, i_am_the_master);
+		std::vector<manifest_job> jobs;
+		if(read_manifest(argv[2], 1, jobs) == SUCCESS)
+			manifest_run(jobs, 1, 1, view_job, NULL);
+		functions_clean();
+	}
 	else {
 		// инициализация библиотеки
 	    functions_init(myrank, proc_num, i_am_the_master);
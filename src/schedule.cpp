@@ -0,0 +1,169 @@
+#include "schedule.h"
+
+#include <algorithm>
+#include <set>
+
+// Граф зависимостей: для каждого кубита помним последний недиагональный на нем вентиль
+// и диагональные после него - следующий недиагональный зависит от всех них.
+// Измерения, кроме того, идут в порядке программы: от порядка зависят случайные исходы и значение
+// классического бита, в который пишут несколько измерений, а выбор готового вентиля зависит от числа процессов
+static void build_dependencies(const std::vector<gate> &gates, const size_t number_of_qubits,
+	std::vector< std::vector<size_t> > &successors, std::vector<size_t> &predecessors_num)
+{
+	const size_t count = gates.size();
+	successors.assign(count, std::vector<size_t>());
+	predecessors_num.assign(count, 0);
+	std::vector<long> last(number_of_qubits + 1, -1);
+	std::vector< std::vector<size_t> > diagonal(number_of_qubits + 1);
+	long last_measure = -1;
+	size_t i, k, m;
+	for(i = 0; i < count; i++)
+	{
+		const gate &g = gates[i];
+		if(g.type == GATE_MEASURE)
+		{
+			if(last_measure >= 0)
+			{
+				successors[last_measure].push_back(i);
+				predecessors_num[i]++;
+			}
+			last_measure = i;
+		}
+		for(k = 0; k < g.qubits_num; k++)
+		{
+			const size_t q = g.qubits[k];
+			if(gate_is_diagonal_on(g, q) || diagonal[q].empty())
+			{
+				if(last[q] >= 0)
+				{
+					successors[last[q]].push_back(i);
+					predecessors_num[i]++;
+				}
+			}
+			else
+			{
+				for(m = 0; m < diagonal[q].size(); m++)
+				{
+					successors[diagonal[q][m]].push_back(i);
+					predecessors_num[i]++;
+				}
+			}
+			if(gate_is_diagonal_on(g, q))
+				diagonal[q].push_back(i);
+			else
+			{
+				diagonal[q].clear();
+				last[q] = i;
+			}
+		}
+	}
+}
+
+static int lowest_bit(const ulong v)
+{
+	int bit = 0;
+	while(!((v >> bit) & 1))
+		bit++;
+	return bit;
+}
+
+static int highest_bit(const ulong v)
+{
+	int bit = 0;
+	while(v >> (bit + 1))
+		bit++;
+	return bit;
+}
+
+void schedule_circuit(std::vector<gate> &gates, const size_t number_of_qubits, const int processes, optimize_report *report)
+{
+	const size_t count = gates.size();
+	const ulong portion_size = (1UL << number_of_qubits) / processes;
+	const ulong cache_size = dense_cache_size(portion_size);
+	std::vector< std::vector<size_t> > successors;
+	std::vector<size_t> predecessors_num;
+	build_dependencies(gates, number_of_qubits, successors, predecessors_num);
+	// моделируем расположение кубитов так же, как apply_circuit_dense
+	qubit_layout layout;
+	layout_init(&layout, number_of_qubits, portion_size);
+	std::set<size_t> ready;
+	size_t i, k;
+	for(i = 0; i < count; i++)
+		if(predecessors_num[i] == 0)
+			ready.insert(i);
+	std::vector<gate> scheduled;
+	scheduled.reserve(count);
+	std::vector<size_t> demand(number_of_qubits + 1);
+	while(!ready.empty())
+	{
+		// 0 - целевые биты в куске, 1 - локальные или измерение, 2 - нужен обмен
+		long best = -1;
+		int best_class = 3;
+		std::set<size_t>::iterator it;
+		for(it = ready.begin(); it != ready.end() && best_class > 0; it++)
+		{
+			const gate &g = gates[*it];
+			ulong targets = g.type == GATE_MEASURE ? cache_size : layout_target_mask(&layout, g);
+			int cls = targets < cache_size ? 0 : (targets < portion_size ? 1 : 2);
+			if(cls < best_class)
+			{
+				best = *it;
+				best_class = cls;
+			}
+		}
+		if(best_class == 2)
+		{
+			// глобальный кубит, нужный многим готовым вентилям, переносим один раз для всех
+			std::fill(demand.begin(), demand.end(), 0);
+			for(it = ready.begin(); it != ready.end(); it++)
+				for(ulong global = layout_target_mask(&layout, gates[*it]) / portion_size; global; global &= global - 1)
+					demand[layout.qubit_at[layout.local_bits + lowest_bit(global)]]++;
+			size_t best_demand = 0;
+			for(it = ready.begin(); it != ready.end(); it++)
+			{
+				size_t sum = 0;
+				for(ulong global = layout_target_mask(&layout, gates[*it]) / portion_size; global; global &= global - 1)
+					sum += demand[layout.qubit_at[layout.local_bits + lowest_bit(global)]];
+				if(sum > best_demand)
+				{
+					best_demand = sum;
+					best = *it;
+				}
+			}
+			const gate &g = gates[best];
+			ulong masks[GATE_MAX_QUBITS], busy = 0, targets;
+			gate_masks(g, number_of_qubits, layout.bit_of, masks);
+			for(k = 0; k < g.qubits_num; k++)
+				busy |= masks[k];
+			while((targets = layout_target_mask(&layout, g)) >= portion_size)
+			{
+				int victim = layout_victim(&layout, gates.data() + best + 1, count - best - 1, busy);
+				if(victim < 0)
+					// выполнить вентиль нельзя; apply_circuit_dense сообщит об ошибке, порядок не меняем
+					return;
+				layout_swap(&layout, victim, highest_bit(targets));
+				busy |= 1UL << victim;
+			}
+		}
+		scheduled.push_back(gates[best]);
+		ready.erase(best);
+		for(k = 0; k < successors[best].size(); k++)
+			if(--predecessors_num[successors[best][k]] == 0)
+				ready.insert(successors[best][k]);
+	}
+	circuit_cost before = { 0, 0, 0 }, after = { 0, 0, 0 };
+	estimate_cost(gates.data(), count, number_of_qubits, processes, &before);
+	estimate_cost(scheduled.data(), count, number_of_qubits, processes, &after);
+	bool better = after.exchanges < before.exchanges || (after.exchanges == before.exchanges && after.sweeps <= before.sweeps);
+	if(better)
+		gates.swap(scheduled);
+	if(report != NULL)
+	{
+		report->before.gates += before.gates;
+		report->before.sweeps += before.sweeps;
+		report->before.exchanges += before.exchanges;
+		report->after.gates += count;
+		report->after.sweeps += better ? after.sweeps : before.sweeps;
+		report->after.exchanges += better ? after.exchanges : before.exchanges;
+	}
+}
@@ -0,0 +1,141 @@
+#include "semiclassical.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+static const double pi = std::acos(-1);
+
+// Кусок пересылки половины активного отрезка между процессами, в амплитудах
+#define SEMICLASSICAL_CHUNK (1UL << 16)
+
+// Суммы по активному отрезку с половинами a0 и a1: |a0|^2, |a1|^2 и sum conj(a0) * a1
+struct stage_sums
+{
+	double norm0;
+	double norm1;
+	double cross_re;
+	double cross_im;
+};
+
+static void add_sums(const complexd *a0, const complexd *a1, const ulong size, stage_sums *sums)
+{
+	long i;
+	const long count = size;
+	double norm0 = 0, norm1 = 0, cross_re = 0, cross_im = 0;
+	#pragma omp parallel for reduction(+:norm0,norm1,cross_re,cross_im)
+	for(i = 0; i < count; i++)
+	{
+		const complexd cross = std::conj(a0[i]) * a1[i];
+		norm0 += std::norm(a0[i]);
+		norm1 += std::norm(a1[i]);
+		cross_re += cross.real();
+		cross_im += cross.imag();
+	}
+	sums->norm0 += norm0;
+	sums->norm1 += norm1;
+	sums->cross_re += cross_re;
+	sums->cross_im += cross_im;
+}
+
+// kept = (a0 + s * a1) * scale; kept может совпадать с a0 или a1
+static void combine(const complexd *a0, const complexd *a1, complexd *kept, const ulong size, const complexd s, const double scale)
+{
+	long i;
+	const long count = size;
+	#pragma omp parallel for
+	for(i = 0; i < count; i++)
+		kept[i] = (a0[i] + s * a1[i]) * scale;
+}
+
+int semiclassical_qft(complexd *portion, const size_t number_of_qubits, ulong *outcome, double *probability)
+{
+	const ulong portion_size = (1UL << number_of_qubits) / proc_num;
+	const ulong first_index = myrank * portion_size;
+	std::vector<complexd> buffer(std::min(SEMICLASSICAL_CHUNK, portion_size));
+	// активный отрезок [begin, begin + length) глобальных индексов: амплитуды с уже измеренными битами prefix
+	ulong begin = 0, length = 1UL << number_of_qubits, prefix = 0;
+	// сумма классически управляемых фаз CP(q, i, pi/2^{q-i}) по измеренным единицам m_i:
+	// angle_{q+1} = (angle_q + m_q * pi) / 2
+	double angle = 0, total_probability = 1;
+	size_t q;
+	for(q = 1; q <= number_of_qubits; q++)
+	{
+		const ulong half = length / 2;
+		const complexd phase = std::polar(1.0, angle);
+		const bool active = first_index >= begin && first_index < begin + length;
+		const bool global = half >= portion_size;
+		// глобальный шаг: процесс нижней половины в паре с процессом верхней, ranks_half выше
+		const int ranks_half = global ? half / portion_size : 0;
+		const bool lower = first_index < begin + half;
+		// локальный шаг: весь отрезок у одного процесса
+		const bool owner = !global && begin / portion_size == ulong(myrank);
+		const ulong offset = begin - std::min(begin, first_index);
+		stage_sums sums = { 0, 0, 0, 0 }, all_sums;
+		ulong done, size;
+		MPI_Status status;
+		if(global && active)
+		{
+			// суммы считает нижний процесс, верхний присылает ему свою половину кусками
+			for(done = 0; done < portion_size; done += size)
+			{
+				size = std::min(SEMICLASSICAL_CHUNK, portion_size - done);
+				if(lower) {
+					MPI_Recv(buffer.data(), size, MPI_DOUBLE_COMPLEX, myrank + ranks_half, 0, MPI_COMM_WORLD, &status);
+					add_sums(portion + done, buffer.data(), size, &sums);
+				}
+				else
+					MPI_Send(portion + done, size, MPI_DOUBLE_COMPLEX, myrank - ranks_half, 0, MPI_COMM_WORLD);
+			}
+		}
+		else if(owner)
+			add_sums(portion + offset, portion + offset + half, half, &sums);
+		MPI_Allreduce(&sums, &all_sums, 4, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+		// фаза на кубите q, адамар и вероятности его исходов: |a0 +- phase * a1|^2 / 2
+		const double total = all_sums.norm0 + all_sums.norm1;
+		const double interference = all_sums.cross_re * phase.real() - all_sums.cross_im * phase.imag();
+		const double probabilities[2] = { std::max(0.0, total / 2 + interference), std::max(0.0, total / 2 - interference) };
+		int result = 0;
+		if(i_am_the_master)
+			result = measurement_uniform() * (probabilities[0] + probabilities[1]) < probabilities[1];
+		MPI_Bcast(&result, 1, MPI_INT, MASTER, MPI_COMM_WORLD);
+		total_probability *= probabilities[result] / (probabilities[0] + probabilities[1]);
+		// остается половина с битом result: (a0 +- phase * a1) / sqrt(2), нормированная
+		const complexd s = result ? -phase : phase;
+		const double scale = 1.0 / sqrt(2 * probabilities[result]);
+		if(global && active)
+		{
+			// оставшемуся процессу пары нужна половина партнера еще раз, отброшенный процесс выходит из работы
+			const bool kept = lower != bool(result);
+			const int partner = lower ? myrank + ranks_half : myrank - ranks_half;
+			for(done = 0; done < portion_size; done += size)
+			{
+				size = std::min(SEMICLASSICAL_CHUNK, portion_size - done);
+				if(!kept)
+					MPI_Send(portion + done, size, MPI_DOUBLE_COMPLEX, partner, 0, MPI_COMM_WORLD);
+				else {
+					MPI_Recv(buffer.data(), size, MPI_DOUBLE_COMPLEX, partner, 0, MPI_COMM_WORLD, &status);
+					if(lower)
+						combine(portion + done, buffer.data(), portion + done, size, s, scale);
+					else
+						combine(buffer.data(), portion + done, portion + done, size, s, scale);
+				}
+			}
+			if(!kept)
+				std::fill(portion, portion + portion_size, complexd(0));
+		}
+		else if(owner)
+		{
+			complexd *a0 = portion + offset, *a1 = a0 + half;
+			combine(a0, a1, result ? a1 : a0, half, s, scale);
+			std::fill(result ? a0 : a1, (result ? a0 : a1) + half, complexd(0));
+		}
+		prefix = (prefix << 1) | result;
+		angle = (angle + result * pi) / 2;
+		begin += result ? half : 0;
+		length = half;
+	}
+	*outcome = prefix;
+	*probability = total_probability;
+	return SUCCESS;
+}
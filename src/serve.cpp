@@ -0,0 +1,255 @@
+#include "serve.h"
+#include "gates.h"
+#include "circuit.h"
+#include "optimize.h"
+#include "schedule.h"
+#include "observe.h"
+#include "batch.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define SERVE_LINE_MAX 4096
+
+// Соединение с клиентом есть только у рутового процесса
+struct server
+{
+	int listener;
+	FILE *in;
+	FILE *out;
+};
+
+static int open_listener(server *srv, const char *socket_path)
+{
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if(strlen(socket_path) >= sizeof(address.sun_path)) {
+		fprintf(stderr, "Socket path %s is too long\n", socket_path);
+		return WRONG_VALUE;
+	}
+	strcpy(address.sun_path, socket_path);
+	srv->listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(srv->listener < 0) {
+		fprintf(stderr, "%s\n", "Cannot create a socket");
+		return errno;
+	}
+	// сокет, оставшийся от прошлого запуска
+	unlink(socket_path);
+	if(bind(srv->listener, (sockaddr *)&address, sizeof(address)) != 0 || listen(srv->listener, 1) != 0) {
+		fprintf(stderr, "Cannot listen on %s\n", socket_path);
+		close(srv->listener);
+		srv->listener = -1;
+		return errno;
+	}
+	// отключившийся клиент не должен ронять сервер при ответе
+	signal(SIGPIPE, SIG_IGN);
+	return SUCCESS;
+}
+
+static void close_client(server *srv)
+{
+	if(srv->in != NULL)
+		fclose(srv->in);
+	if(srv->out != NULL)
+		fclose(srv->out);
+	srv->in = NULL;
+	srv->out = NULL;
+}
+
+static void reply(server *srv, const char *format, ...)
+{
+	if(!i_am_the_master || srv->out == NULL)
+		return;
+	va_list args;
+	va_start(args, format);
+	vfprintf(srv->out, format, args);
+	va_end(args);
+	fputc('\n', srv->out);
+}
+
+// Рутовый процесс ждет непустую строку от клиента (если клиент отключился - от следующего) и рассылает ее
+static std::string next_command(server *srv)
+{
+	char line[SERVE_LINE_MAX] = "";
+	int length = 0;
+	while(i_am_the_master)
+	{
+		if(srv->in == NULL)
+		{
+			int client = accept(srv->listener, NULL, NULL);
+			if(client < 0) {
+				if(errno == EINTR)
+					continue;
+				strcpy(line, "shutdown");
+				break;
+			}
+			srv->in = fdopen(client, "r");
+			srv->out = fdopen(dup(client), "w");
+		}
+		if(fgets(line, sizeof(line), srv->in) == NULL) {
+			close_client(srv);
+			continue;
+		}
+		line[strcspn(line, "\r\n")] = '\0';
+		if(line[0] != '\0')
+			break;
+	}
+	if(i_am_the_master)
+		length = strlen(line);
+	MPI_Bcast(&length, 1, MPI_INT, MASTER, MPI_COMM_WORLD);
+	MPI_Bcast(line, length + 1, MPI_CHAR, MASTER, MPI_COMM_WORLD);
+	return line;
+}
+
+static void reset_state(complexd *portion, const size_t number_of_qubits)
+{
+	const ulong portion_size = (1UL << number_of_qubits) / proc_num;
+	std::fill(portion, portion + portion_size, complexd(0));
+	if(i_am_the_master)
+		portion[0] = 1;
+}
+
+static std::string bit_string(const ulong index, const size_t number_of_qubits)
+{
+	std::string bits;
+	size_t q;
+	for(q = 1; q <= number_of_qubits; q++)
+		bits += (index >> (number_of_qubits - q)) & 1 ? '1' : '0';
+	return bits;
+}
+
+static int apply_file(server *srv, complexd *portion, const size_t number_of_qubits, const bool optimize, const char *circuit_file)
+{
+	std::vector<gate> gates;
+	int code = read_circuit(circuit_file, number_of_qubits, gates);
+	if(code != SUCCESS)
+		return code;
+	if(optimize) {
+		optimize_circuit(gates, number_of_qubits);
+		schedule_circuit(gates, number_of_qubits, proc_num);
+	}
+	std::vector<int> bits;
+	code = apply_circuit_dense(portion, number_of_qubits, gates.data(), gates.size(), &bits);
+	if(code == SUCCESS && !bits.empty())
+	{
+		std::string line;
+		size_t k;
+		for(k = 0; k < bits.size(); k++)
+			line += bits[k] ? '1' : '0';
+		reply(srv, "c = %s", line.c_str());
+	}
+	return code;
+}
+
+static int sample(server *srv, const complexd *portion, const size_t number_of_qubits, const char *shots_arg)
+{
+	char *end = NULL;
+	const long shots = strtol(shots_arg, &end, 10);
+	if(*end != '\0' || shots <= 0)
+		return WRONG_VALUE;
+	std::vector<ulong> samples;
+	int code = sample_state(portion, number_of_qubits, shots, samples);
+	size_t k, first;
+	// выборка упорядочена, одинаковые индексы идут подряд
+	for(first = 0; code == SUCCESS && first < samples.size(); first = k)
+	{
+		for(k = first; k < samples.size() && samples[k] == samples[first]; k++)
+			;
+		reply(srv, "%s %zu", bit_string(samples[first], number_of_qubits).c_str(), k - first);
+	}
+	return code;
+}
+
+// Коллективная: все процессы выполняют одну и ту же команду
+static int execute(server *srv, complexd *portion, const size_t number_of_qubits, const bool optimize,
+	const std::string &command, bool *disconnect, bool *stop)
+{
+	char name[32] = "", argument[SERVE_LINE_MAX] = "";
+	sscanf(command.c_str(), "%31s %4095s", name, argument);
+	const bool has_argument = argument[0] != '\0';
+	if(strcmp(name, "load") == 0 && has_argument)
+		return batch_read_vectors(portion, number_of_qubits, std::vector<std::string>(1, argument));
+	if(strcmp(name, "snapshot") == 0 && has_argument)
+		return batch_write_vectors(portion, number_of_qubits, std::vector<std::string>(1, argument));
+	if(strcmp(name, "apply") == 0 && has_argument)
+		return apply_file(srv, portion, number_of_qubits, optimize, argument);
+	if(strcmp(name, "sample") == 0 && has_argument)
+		return sample(srv, portion, number_of_qubits, argument);
+	if(strcmp(name, "expect") == 0 && has_argument)
+	{
+		double value = 0;
+		int code = pauli_expectation(portion, number_of_qubits, argument, &value);
+		if(code == SUCCESS)
+			reply(srv, "%.15g", value);
+		return code;
+	}
+	if(strcmp(name, "reset") == 0) {
+		reset_state(portion, number_of_qubits);
+		return SUCCESS;
+	}
+	if(strcmp(name, "quit") == 0) {
+		*disconnect = true;
+		return SUCCESS;
+	}
+	if(strcmp(name, "shutdown") == 0) {
+		*stop = true;
+		return SUCCESS;
+	}
+	return WRONG_VALUE;
+}
+
+int serve(const char *socket_path, const size_t number_of_qubits, const bool optimize)
+{
+	complexd *portion = NULL;
+	int code = mymalloc(&portion, number_of_qubits);
+	if(code != SUCCESS)
+		return code;
+	reset_state(portion, number_of_qubits);
+	server srv = { -1, NULL, NULL };
+	if(i_am_the_master)
+		code = open_listener(&srv, socket_path);
+	MPI_Bcast(&code, 1, MPI_INT, MASTER, MPI_COMM_WORLD);
+	if(code != SUCCESS) {
+		myfree(portion);
+		return code;
+	}
+	if(i_am_the_master) {
+		printf("Serving %zu qubits on %s\n", number_of_qubits, socket_path);
+		fflush(stdout);
+	}
+	bool stop = false;
+	size_t commands = 0;
+	while(!stop)
+	{
+		bool disconnect = false;
+		std::string command = next_command(&srv);
+		code = execute(&srv, portion, number_of_qubits, optimize, command, &disconnect, &stop);
+		commands++;
+		if(code == SUCCESS)
+			reply(&srv, "OK");
+		else
+			reply(&srv, "ERROR %d", code);
+		if(i_am_the_master && srv.out != NULL)
+			fflush(srv.out);
+		if(disconnect && i_am_the_master)
+			close_client(&srv);
+	}
+	if(i_am_the_master)
+	{
+		close_client(&srv);
+		close(srv.listener);
+		unlink(socket_path);
+		printf("Served %zu commands\n", commands);
+	}
+	myfree(portion);
+	return SUCCESS;
+}
@@ -0,0 +1,180 @@
+#include "shm.h"
+
+#include <cstddef>
+#include <string>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static std::string segment_name(const char *name, const char *suffix)
+{
+	std::string segment(name[0] == '/' ? "" : "/");
+	return segment + name + suffix;
+}
+
+static bool all_on_one_node()
+{
+	MPI_Comm node;
+	int node_size = 0;
+	MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node);
+	MPI_Comm_size(node, &node_size);
+	MPI_Comm_free(&node);
+	return node_size == proc_num;
+}
+
+// Отображает часть процесса; смещение части в сегменте не обязано быть кратно странице
+static int map_portion(const char *name, const size_t number_of_qubits, const bool writable, shm_portion *mapping)
+{
+	const std::string data = segment_name(name, ".data");
+	int fd = shm_open(data.c_str(), writable ? O_RDWR : O_RDONLY, 0);
+	if(fd < 0) {
+		fprintf(stderr, "Cannot open shared memory %s\n", data.c_str());
+		return errno;
+	}
+	const ulong portion_size = (1UL << number_of_qubits) / proc_num;
+	const size_t bytes = portion_size * sizeof(complexd);
+	const off_t offset = myrank * bytes;
+	struct stat st;
+	if(fstat(fd, &st) != 0 || st.st_size < off_t(bytes * proc_num)) {
+		fprintf(stderr, "Shared memory %s is smaller than the vector\n", data.c_str());
+		close(fd);
+		return WRONG_VALUE;
+	}
+	const off_t aligned = offset - offset % sysconf(_SC_PAGESIZE);
+	mapping->length = offset - aligned + bytes;
+	mapping->base = mmap(NULL, mapping->length, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, aligned);
+	close(fd);
+	if(mapping->base == MAP_FAILED) {
+		fprintf(stderr, "Cannot map shared memory %s\n", data.c_str());
+		mapping->base = NULL;
+		return errno;
+	}
+	mapping->portion = (complexd *)((char *)mapping->base + (offset - aligned));
+	return SUCCESS;
+}
+
+void shm_detach(shm_portion *mapping)
+{
+	if(mapping->base != NULL)
+		munmap(mapping->base, mapping->length);
+	mapping->base = NULL;
+	mapping->portion = NULL;
+}
+
+int shm_remove(const char *name)
+{
+	int code = SUCCESS;
+	if(shm_unlink(segment_name(name, ".data").c_str()) != 0)
+		code = errno;
+	if(shm_unlink(segment_name(name, "").c_str()) != 0)
+		code = errno;
+	return code;
+}
+
+int shm_create(const char *name, const size_t number_of_qubits, shm_portion *mapping)
+{
+	mapping->base = NULL;
+	mapping->portion = NULL;
+	if(!all_on_one_node()) {
+		if(i_am_the_master)
+			fprintf(stderr, "%s\n", "Shared memory export needs all processes on one node");
+		return WRONG_VALUE;
+	}
+	int code = SUCCESS;
+	if(i_am_the_master)
+	{
+		shm_remove(name);
+		const std::string data = segment_name(name, ".data"), meta = segment_name(name, "");
+		int fd = shm_open(data.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+		if(fd < 0)
+			code = errno;
+		else {
+			// память выделяется сразу: нехватка места в /dev/shm обнаружится здесь, а не при записи
+			code = posix_fallocate(fd, 0, (1UL << number_of_qubits) * sizeof(complexd));
+			close(fd);
+		}
+		shm_header header = { SHM_MAGIC, 0, number_of_qubits, proc_num };
+		fd = code == SUCCESS ? shm_open(meta.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644) : -1;
+		if(code == SUCCESS && fd < 0)
+			code = errno;
+		if(fd >= 0) {
+			if(write(fd, &header, sizeof(header)) != sizeof(header))
+				code = NOT_SUCCESS;
+			close(fd);
+		}
+		if(code != SUCCESS) {
+			fprintf(stderr, "Cannot create shared memory %s\n", data.c_str());
+			shm_remove(name);
+		}
+	}
+	MPI_Bcast(&code, 1, MPI_INT, MASTER, MPI_COMM_WORLD);
+	if(code != SUCCESS)
+		return code;
+	code = map_portion(name, number_of_qubits, true, mapping);
+	code = collective_code(code);
+	if(code != SUCCESS)
+		shm_detach(mapping);
+	return code;
+}
+
+int shm_publish(const char *name, shm_portion *mapping)
+{
+	shm_detach(mapping);
+	// все части записаны: отображения MAP_SHARED видны другим процессам сразу
+	MPI_Barrier(MPI_COMM_WORLD);
+	int code = SUCCESS;
+	if(i_am_the_master)
+	{
+		const std::string meta = segment_name(name, "");
+		const unsigned int ready = 1;
+		int fd = shm_open(meta.c_str(), O_RDWR, 0);
+		if(fd < 0 || pwrite(fd, &ready, sizeof(ready), offsetof(shm_header, ready)) != sizeof(ready)) {
+			fprintf(stderr, "Cannot publish shared memory %s\n", meta.c_str());
+			code = NOT_SUCCESS;
+		}
+		if(fd >= 0)
+			close(fd);
+	}
+	MPI_Bcast(&code, 1, MPI_INT, MASTER, MPI_COMM_WORLD);
+	return code;
+}
+
+int shm_attach(const char *name, size_t *number_of_qubits, shm_portion *mapping)
+{
+	mapping->base = NULL;
+	mapping->portion = NULL;
+	shm_header header = { 0, 0, 0, 0 };
+	int code = SUCCESS;
+	if(i_am_the_master)
+	{
+		const std::string meta = segment_name(name, "");
+		int fd = shm_open(meta.c_str(), O_RDONLY, 0);
+		if(fd < 0 || read(fd, &header, sizeof(header)) != sizeof(header) || header.magic != SHM_MAGIC) {
+			fprintf(stderr, "No vector in shared memory %s\n", meta.c_str());
+			code = WRONG_VALUE;
+		}
+		else if(!header.ready) {
+			fprintf(stderr, "Vector in shared memory %s is not complete\n", meta.c_str());
+			code = WRONG_VALUE;
+		}
+		else if((1UL << header.number_of_qubits) < ulong(proc_num)) {
+			fprintf(stderr, "Vector in shared memory %s is too small for %d processes\n", meta.c_str(), proc_num);
+			code = WRONG_VALUE;
+		}
+		if(fd >= 0)
+			close(fd);
+	}
+	MPI_Bcast(&code, 1, MPI_INT, MASTER, MPI_COMM_WORLD);
+	if(code != SUCCESS)
+		return code;
+	MPI_Bcast(&header.number_of_qubits, 1, MPI_UNSIGNED_LONG, MASTER, MPI_COMM_WORLD);
+	*number_of_qubits = header.number_of_qubits;
+	code = map_portion(name, *number_of_qubits, false, mapping);
+	code = collective_code(code);
+	if(code != SUCCESS)
+		shm_detach(mapping);
+	return code;
+}
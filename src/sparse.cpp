@@ -0,0 +1,411 @@
+#include "sparse.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <errno.h>
+
+// Амплитуды, меньшие по модулю, считаются нулями, возникшими из-за сокращений
+const double sparse_eps = 1e-14;
+
+static inline ulong hash_index(ulong x)
+{
+	// splitmix64
+	x += 0x9e3779b97f4a7c15UL;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9UL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebUL;
+	return x ^ (x >> 31);
+}
+
+int sparse_owner(const ulong index)
+{
+	return (hash_index(index) >> 32) % proc_num;
+}
+
+void sparse_map::grow()
+{
+	std::vector<ulong> old_keys;
+	std::vector<complexd> old_values;
+	old_keys.swap(keys);
+	old_values.swap(values);
+	keys.assign(old_keys.empty() ? 16 : 2 * old_keys.size(), SPARSE_EMPTY);
+	values.assign(keys.size(), 0);
+	count = 0;
+	ulong slot;
+	for(slot = 0; slot < old_keys.size(); slot++)
+		if(old_keys[slot] != SPARSE_EMPTY)
+			add(old_keys[slot], old_values[slot]);
+}
+
+void sparse_map::add(const ulong index, const complexd value)
+{
+	// заполненность не больше половины, иначе пробирование становится длинным
+	if(2 * (count + 1) > keys.size())
+		grow();
+	const ulong mask = keys.size() - 1;
+	ulong slot = hash_index(index) & mask;
+	while(keys[slot] != SPARSE_EMPTY && keys[slot] != index)
+		slot = (slot + 1) & mask;
+	if(keys[slot] == SPARSE_EMPTY)
+	{
+		keys[slot] = index;
+		values[slot] = 0;
+		count++;
+	}
+	values[slot] += value;
+}
+
+complexd sparse_map::get(const ulong index) const
+{
+	if(keys.empty())
+		return 0;
+	const ulong mask = keys.size() - 1;
+	ulong slot = hash_index(index) & mask;
+	while(keys[slot] != SPARSE_EMPTY)
+	{
+		if(keys[slot] == index)
+			return values[slot];
+		slot = (slot + 1) & mask;
+	}
+	return 0;
+}
+
+void sparse_map::clear()
+{
+	keys.clear();
+	values.clear();
+	count = 0;
+}
+
+void sparse_map::prune(const double eps)
+{
+	// перестраиваем таблицу: удаление при линейном пробировании иначе ломает цепочки
+	std::vector<ulong> old_keys;
+	std::vector<complexd> old_values;
+	old_keys.swap(keys);
+	old_values.swap(values);
+	clear();
+	ulong slot;
+	for(slot = 0; slot < old_keys.size(); slot++)
+		if(old_keys[slot] != SPARSE_EMPTY && std::abs(old_values[slot]) >= eps)
+			add(old_keys[slot], old_values[slot]);
+}
+
+// Рассылает элементы процессам: outgoing[p] уходит процессу p, все полученные складываются в incoming
+static int exchange_entries(std::vector< std::vector<sparse_entry> > &outgoing, std::vector<sparse_entry> &incoming)
+{
+	std::vector<int> send_counts(proc_num), recv_counts(proc_num), send_displs(proc_num), recv_displs(proc_num);
+	std::vector<sparse_entry> send_buffer;
+	int p;
+	for(p = 0; p < proc_num; p++)
+	{
+		send_counts[p] = outgoing[p].size() * sizeof(sparse_entry);
+		send_displs[p] = send_buffer.size() * sizeof(sparse_entry);
+		send_buffer.insert(send_buffer.end(), outgoing[p].begin(), outgoing[p].end());
+	}
+	int code = MPI_Alltoall(send_counts.data(), 1, MPI_INT, recv_counts.data(), 1, MPI_INT, MPI_COMM_WORLD);
+	if(code != MPI_SUCCESS)
+		return code;
+	int total = 0;
+	for(p = 0; p < proc_num; p++)
+	{
+		recv_displs[p] = total;
+		total += recv_counts[p];
+	}
+	incoming.resize(total / sizeof(sparse_entry));
+	code = MPI_Alltoallv(send_buffer.data(), send_counts.data(), send_displs.data(), MPI_BYTE,
+	                     incoming.data(), recv_counts.data(), recv_displs.data(), MPI_BYTE, MPI_COMM_WORLD);
+	return code == MPI_SUCCESS ? SUCCESS : code;
+}
+
+int sparse_init(sparse_state *state, const size_t number_of_qubits)
+{
+	if(number_of_qubits == 0 || number_of_qubits > 63)
+	{
+		fprintf(stderr, "%s\n", "Wrong number of qubits");
+		return WRONG_VALUE;
+	}
+	state->number_of_qubits = number_of_qubits;
+	state->amplitudes.clear();
+	return SUCCESS;
+}
+
+int sparse_set_basis(sparse_state *state, const ulong index)
+{
+	state->amplitudes.clear();
+	if(sparse_owner(index) == myrank)
+		state->amplitudes.add(index, 1.0);
+	return SUCCESS;
+}
+
+ulong sparse_count(const sparse_state *state)
+{
+	ulong count = state->amplitudes.size(), all_count = 0;
+	MPI_Allreduce(&count, &all_count, 1, MPI_UNSIGNED_LONG, MPI_SUM, MPI_COMM_WORLD);
+	return all_count;
+}
+
+double sparse_norm(const sparse_state *state)
+{
+	const sparse_map &map = state->amplitudes;
+	double sum_of_squares = 0, all_sum = 0;
+	ulong slot;
+	for(slot = 0; slot < map.capacity(); slot++)
+		if(map.used(slot))
+			sum_of_squares += std::norm(map.value(slot));
+	MPI_Allreduce(&sum_of_squares, &all_sum, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+	return sqrt(all_sum);
+}
+
+// Диагональный вентиль меняет амплитуды на месте, без пересылок
+static void apply_diagonal_sparse(sparse_map &map, const gate &g, const ulong *masks)
+{
+	const complexd i_unit(0, 1);
+	complexd phase0 = 1, phase1;
+	ulong mask = masks[0];
+	switch(g.type)
+	{
+		case GATE_Z:
+			phase1 = -1;
+			break;
+		case GATE_RZ:
+			phase0 = std::exp(-i_unit*g.param/2.0);
+			phase1 = std::exp(i_unit*g.param/2.0);
+			break;
+		default:
+			// GATE_CP
+			mask |= masks[1];
+			phase1 = std::exp(i_unit*g.param);
+			break;
+	}
+	ulong slot;
+	for(slot = 0; slot < map.capacity(); slot++)
+		if(map.used(slot))
+			map.value(slot) *= ((map.key(slot) & mask) == mask) ? phase1 : phase0;
+}
+
+static int apply_gate_sparse(sparse_state *state, const gate &g)
+{
+	ulong masks[GATE_MAX_QUBITS];
+	gate_masks(g, state->number_of_qubits, NULL, masks);
+	sparse_map &map = state->amplitudes;
+	if(gate_is_diagonal(g))
+	{
+		apply_diagonal_sparse(map, g, masks);
+		return SUCCESS;
+	}
+	// матрица 2x2 для ветвящихся вентилей: новая амплитуда = m * старая
+	const double r = 1.0/sqrt(2);
+	const complexd i_unit(0, 1);
+	complexd m[4];
+	bool branching = false;
+	if(g.type == GATE_H)
+	{
+		m[0] = r; m[1] = r; m[2] = r; m[3] = -r;
+		branching = true;
+	}
+	else if(g.type == GATE_RX)
+	{
+		m[0] = m[3] = cos(g.param/2);
+		m[1] = m[2] = -i_unit * sin(g.param/2);
+		branching = true;
+	}
+	else if(g.type != GATE_X && g.type != GATE_CX && g.type != GATE_CCX && g.type != GATE_SWAP)
+	{
+		fprintf(stderr, "%s\n", "Unsupported gate in sparse mode");
+		return WRONG_VALUE;
+	}
+	// каждая ненулевая амплитуда дает вклад в одну или две новые, вклады уходят владельцам индексов
+	std::vector< std::vector<sparse_entry> > outgoing(proc_num);
+	ulong slot;
+	for(slot = 0; slot < map.capacity(); slot++)
+	{
+		if(!map.used(slot))
+			continue;
+		ulong index = map.key(slot);
+		complexd value = map.value(slot);
+		sparse_entry e;
+		if(branching)
+		{
+			int bit = (index & masks[0]) ? 1 : 0;
+			e.index = index & ~masks[0];
+			e.value = m[bit] * value;
+			outgoing[sparse_owner(e.index)].push_back(e);
+			e.index = index | masks[0];
+			e.value = m[2 + bit] * value;
+			outgoing[sparse_owner(e.index)].push_back(e);
+			continue;
+		}
+		e.index = index;
+		e.value = value;
+		switch(g.type)
+		{
+			case GATE_X:
+				e.index ^= masks[0];
+				break;
+			case GATE_CX:
+				if(index & masks[0])
+					e.index ^= masks[1];
+				break;
+			case GATE_CCX:
+				if((index & masks[0]) && (index & masks[1]))
+					e.index ^= masks[2];
+				break;
+			case GATE_SWAP:
+				if(!(index & masks[0]) != !(index & masks[1]))
+					e.index ^= masks[0] | masks[1];
+				break;
+		}
+		outgoing[sparse_owner(e.index)].push_back(e);
+	}
+	std::vector<sparse_entry> incoming;
+	int code = exchange_entries(outgoing, incoming);
+	if(code != SUCCESS)
+		return code;
+	map.clear();
+	size_t k;
+	for(k = 0; k < incoming.size(); k++)
+		map.add(incoming[k].index, incoming[k].value);
+	if(branching)
+		map.prune(sparse_eps);
+	return SUCCESS;
+}
+
+int sparse_to_dense(sparse_state *state, complexd *portion)
+{
+	const ulong portion_size = (1UL << state->number_of_qubits) / proc_num;
+	sparse_map &map = state->amplitudes;
+	std::vector< std::vector<sparse_entry> > outgoing(proc_num);
+	ulong slot;
+	for(slot = 0; slot < map.capacity(); slot++)
+		if(map.used(slot))
+		{
+			sparse_entry e;
+			e.index = map.key(slot);
+			e.value = map.value(slot);
+			outgoing[e.index / portion_size].push_back(e);
+		}
+	std::vector<sparse_entry> incoming;
+	int code = exchange_entries(outgoing, incoming);
+	if(code != SUCCESS)
+		return code;
+	ulong i;
+	for(i = 0; i < portion_size; i++)
+		portion[i] = 0;
+	for(i = 0; i < incoming.size(); i++)
+		portion[incoming[i].index - myrank * portion_size] = incoming[i].value;
+	zero_tracking_refresh(portion);
+	map.clear();
+	return SUCCESS;
+}
+
+int sparse_apply_circuit(sparse_state *state, const gate *gates, const size_t count, const double promote_density, complexd **portion)
+{
+	*portion = NULL;
+	const double size = std::ldexp(1.0, state->number_of_qubits);
+	size_t i;
+	int code;
+	for(i = 0; i < count; i++)
+	{
+		if(gates[i].type == GATE_MEASURE)
+		{
+			fprintf(stderr, "%s\n", "Measurement is not supported in sparse mode");
+			return WRONG_VALUE;
+		}
+		if((code = apply_gate_sparse(state, gates[i])) != SUCCESS)
+			return code;
+		if(gate_is_diagonal(gates[i]) || sparse_count(state) <= promote_density * size)
+			continue;
+		// вектор стал плотным: дальше считаем обычным распределенным вектором
+		if(i_am_the_master)
+			printf("Sparse: promoted to dense after gate %zu\n", i + 1);
+		if((code = mymalloc(portion, state->number_of_qubits)) != SUCCESS)
+			return code;
+		if((code = sparse_to_dense(state, *portion)) != SUCCESS)
+			return code;
+		return apply_circuit_dense(*portion, state->number_of_qubits, gates + i + 1, count - i - 1);
+	}
+	return SUCCESS;
+}
+
+int sparse_read_vector_from_file(sparse_state *state, const char *filename)
+{
+	int code = SUCCESS;
+	int fd = open(filename, O_RDONLY);
+	if(fd < 0) {
+		fprintf(stderr, "Cannot open file %s\n", filename);
+		code = errno;
+	}
+	// каждый процесс просматривает свой непрерывный кусок файла и рассылает ненулевые элементы владельцам
+	const ulong portion_size = (1UL << state->number_of_qubits) / proc_num;
+	const ulong first_index = myrank * portion_size;
+	const ulong buffer_size = std::min(portion_size, 1UL << 16);
+	std::vector<complexd> buffer(buffer_size);
+	std::vector< std::vector<sparse_entry> > outgoing(proc_num);
+	ulong start, i;
+	for(start = 0; start < portion_size && code == SUCCESS; start += buffer_size)
+	{
+		size_t bytes = buffer_size * sizeof(complexd);
+		ssize_t n = pread(fd, buffer.data(), bytes, (first_index + start) * sizeof(complexd));
+		if(n != (ssize_t)bytes) {
+			code = NOT_SUCCESS;
+			break;
+		}
+		for(i = 0; i < buffer_size; i++)
+			if(buffer[i] != 0.0)
+			{
+				sparse_entry e;
+				e.index = first_index + start + i;
+				e.value = buffer[i];
+				outgoing[sparse_owner(e.index)].push_back(e);
+			}
+	}
+	if(fd >= 0)
+		close(fd);
+	// при ошибке процесс все равно участвует в обмене, но ничего не рассылает
+	if(code != SUCCESS) {
+		fprintf(stderr, "Error when reading file %s\n", filename);
+		for(i = 0; i < outgoing.size(); i++)
+			outgoing[i].clear();
+	}
+	std::vector<sparse_entry> incoming;
+	int exchange_code = exchange_entries(outgoing, incoming);
+	state->amplitudes.clear();
+	for(i = 0; i < incoming.size(); i++)
+		state->amplitudes.add(incoming[i].index, incoming[i].value);
+	return collective_code(code == SUCCESS ? exchange_code : code);
+}
+
+int sparse_write_vector_to_file(const sparse_state *state, const char *filename)
+{
+	// рутовый процесс создает файл нужной длины из нулей, затем каждый процесс пишет свои ненулевые элементы
+	int code = SUCCESS;
+	if(i_am_the_master)
+	{
+		int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if(fd < 0 || ftruncate(fd, (1UL << state->number_of_qubits) * sizeof(complexd)) != 0)
+			code = NOT_SUCCESS;
+		if(fd >= 0)
+			close(fd);
+	}
+	MPI_Bcast(&code, 1, MPI_INT, MASTER, MPI_COMM_WORLD);
+	if(code != SUCCESS) {
+		fprintf(stderr, "Error when opening file %s\n", filename);
+		return code;
+	}
+	int fd = open(filename, O_WRONLY);
+	const sparse_map &map = state->amplitudes;
+	ulong slot;
+	for(slot = 0; slot < map.capacity() && fd >= 0; slot++)
+		if(map.used(slot) && pwrite(fd, &map.value(slot), sizeof(complexd), map.key(slot) * sizeof(complexd)) != sizeof(complexd))
+			code = NOT_SUCCESS;
+	if(fd < 0)
+		code = errno;
+	else
+		close(fd);
+	if(code != SUCCESS)
+		fprintf(stderr, "Error when writing to file %s\n", filename);
+	return collective_code(code);
+}
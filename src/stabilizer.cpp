@@ -0,0 +1,363 @@
+#include "stabilizer.h"
+#include "observe.h"
+
+#include <algorithm>
+#include <cmath>
+
+static const double pi = std::acos(-1);
+static const complexd i_powers[4] = { complexd(1, 0), complexd(0, 1), complexd(-1, 0), complexd(0, -1) };
+
+static inline ulong top_bit(const ulong v)
+{
+	ulong bit = 1UL << 63;
+	while(!(v & bit))
+		bit >>= 1;
+	return bit;
+}
+
+static inline size_t lowest_bit_number(ulong v)
+{
+	size_t number = 0;
+	for(; !(v & 1); v >>= 1)
+		number++;
+	return number;
+}
+
+// a * b: Z^z1 переставляется через X^x2, по -1 на каждый общий кубит
+static inline pauli_row multiply(const pauli_row &a, const pauli_row &b)
+{
+	pauli_row result = { a.x ^ b.x, a.z ^ b.z, (a.phase + b.phase + 2 * parity(a.z & b.x)) & 3 };
+	return result;
+}
+
+// <reference ^ g.x|psi> по <reference|psi> = amplitude для элемента g группы стабилизатора:
+// psi = g psi, а g|y> = i^phase * (-1)^{z.y} |y ^ x>
+static inline complexd element_amplitude(const pauli_row &g, const ulong reference, const complexd amplitude)
+{
+	const complexd value = i_powers[g.phase] * amplitude;
+	return parity(g.z & reference) ? -value : value;
+}
+
+// Приведенный ступенчатый вид по X-частям: первые k строк с ненулевой X-частью упорядочены по убыванию
+// ведущего бита, ведущий бит есть только в своей строке. Возвращает k
+static size_t reduce_rows(std::vector<pauli_row> &rows, const size_t number_of_qubits)
+{
+	size_t k = 0, i, j;
+	ulong bit;
+	for(bit = 1UL << (number_of_qubits - 1); bit != 0 && k < rows.size(); bit >>= 1)
+	{
+		for(j = k; j < rows.size() && !(rows[j].x & bit); j++);
+		if(j == rows.size())
+			continue;
+		std::swap(rows[k], rows[j]);
+		for(i = 0; i < rows.size(); i++)
+			if(i != k && (rows[i].x & bit))
+				rows[i] = multiply(rows[i], rows[k]);
+		k++;
+	}
+	return k;
+}
+
+// Элемент группы стабилизатора с X-частью target, если он есть
+static bool find_element(const std::vector<pauli_row> &generators, const size_t number_of_qubits, ulong target, pauli_row *element)
+{
+	std::vector<pauli_row> rows(generators);
+	const size_t k = reduce_rows(rows, number_of_qubits);
+	pauli_row result = { 0, 0, 0 };
+	size_t i;
+	for(i = 0; i < k; i++)
+		if(target & top_bit(rows[i].x)) {
+			result = multiply(result, rows[i]);
+			target ^= rows[i].x;
+		}
+	*element = result;
+	return target == 0;
+}
+
+// Угол, кратный step: *multiple - множитель по модулю 4
+static bool angle_multiple(const double angle, const double step, int *multiple)
+{
+	const double ratio = angle / step;
+	const double rounded = floor(ratio + 0.5);
+	if(fabs(ratio - rounded) > 1e-12)
+		return false;
+	*multiple = int(fmod(rounded, 4) + 4) % 4;
+	return true;
+}
+
+bool is_clifford(const gate &g)
+{
+	int multiple;
+	switch(g.type)
+	{
+		case GATE_H:
+		case GATE_X:
+		case GATE_Z:
+		case GATE_CX:
+		case GATE_SWAP:
+			return true;
+		case GATE_RZ:
+		case GATE_RX:
+			return angle_multiple(g.param, pi / 2, &multiple);
+		case GATE_CP:
+			return angle_multiple(g.param, pi, &multiple);
+		default:
+			return false;
+	}
+}
+
+void stabilizer_set_basis(stabilizer_state *state, const size_t number_of_qubits, const ulong index, const complexd amplitude)
+{
+	state->number_of_qubits = number_of_qubits;
+	state->rows.resize(number_of_qubits);
+	size_t k;
+	for(k = 0; k < number_of_qubits; k++)
+	{
+		// (-1)^{b_k} Z_k
+		const ulong mask = 1UL << k;
+		state->rows[k].x = 0;
+		state->rows[k].z = mask;
+		state->rows[k].phase = (index & mask) ? 2 : 0;
+	}
+	state->reference = index;
+	state->amplitude = amplitude;
+}
+
+int stabilizer_from_vector(stabilizer_state *state, const complexd *portion, const size_t number_of_qubits, bool *basis)
+{
+	const ulong portion_size = (1UL << number_of_qubits) / proc_num;
+	long i, nonzero = 0;
+	const long size = portion_size;
+	#pragma omp parallel for reduction(+:nonzero)
+	for(i = 0; i < size; i++)
+		if(portion[i] != complexd(0))
+			nonzero++;
+	long all_nonzero;
+	MPI_Allreduce(&nonzero, &all_nonzero, 1, MPI_LONG, MPI_SUM, MPI_COMM_WORLD);
+	*basis = all_nonzero == 1;
+	if(!*basis)
+		return SUCCESS;
+	// ненулевая амплитуда у одного процесса, остальные дают нули
+	ulong local = 0, all_index;
+	while(nonzero && portion[local] == complexd(0))
+		local++;
+	ulong index = nonzero ? myrank * portion_size + local : 0;
+	complexd amplitude = nonzero ? portion[local] : complexd(0), all_amplitude;
+	MPI_Allreduce(&index, &all_index, 1, MPI_UNSIGNED_LONG, MPI_SUM, MPI_COMM_WORLD);
+	MPI_Allreduce(&amplitude, &all_amplitude, 1, MPI_DOUBLE_COMPLEX, MPI_SUM, MPI_COMM_WORLD);
+	stabilizer_set_basis(state, number_of_qubits, all_index, all_amplitude);
+	return SUCCESS;
+}
+
+// Сопряжения P -> U P U^+ строк и пересчет опорной амплитуды. Для вентилей-перестановок с фазой
+// U|y> = c_y |f(y)> опорный индекс переходит в f(reference), амплитуда умножается на c_reference
+
+static void apply_hadamard(stabilizer_state *state, const ulong mask)
+{
+	// <reference ^ mask|psi> до вентиля, ноль вне носителя
+	pauli_row element;
+	const complexd a = state->amplitude;
+	const complexd b = find_element(state->rows, state->number_of_qubits, mask, &element)
+		? element_amplitude(element, state->reference, a) : complexd(0);
+	const bool one = state->reference & mask;
+	const double r = 1 / sqrt(2.0);
+	const complexd same = (one ? b - a : a + b) * r, flipped = (one ? a + b : a - b) * r;
+	// амплитуды носителя равны по модулю, поэтому same либо ноль, либо не меньше |a|
+	if(std::norm(same) > std::norm(a) / 4)
+		state->amplitude = same;
+	else {
+		state->reference ^= mask;
+		state->amplitude = flipped;
+	}
+	std::vector<pauli_row>::iterator row;
+	for(row = state->rows.begin(); row != state->rows.end(); ++row)
+	{
+		// H X^x Z^z H = Z^x X^z = (-1)^{xz} X^z Z^x
+		const bool x = row->x & mask, z = row->z & mask;
+		if(x && z)
+			row->phase = (row->phase + 2) & 3;
+		if(x != z) {
+			row->x ^= mask;
+			row->z ^= mask;
+		}
+	}
+}
+
+// diag(1, i^multiple)
+static void apply_phase(stabilizer_state *state, const ulong mask, const int multiple)
+{
+	if(state->reference & mask)
+		state->amplitude *= i_powers[multiple];
+	std::vector<pauli_row>::iterator row;
+	int k;
+	for(k = 0; k < multiple; k++)
+		for(row = state->rows.begin(); row != state->rows.end(); ++row)
+			// S X S^+ = iXZ
+			if(row->x & mask) {
+				row->phase = (row->phase + 1) & 3;
+				row->z ^= mask;
+			}
+}
+
+static void apply_x(stabilizer_state *state, const ulong mask)
+{
+	state->reference ^= mask;
+	std::vector<pauli_row>::iterator row;
+	for(row = state->rows.begin(); row != state->rows.end(); ++row)
+		if(row->z & mask)
+			row->phase = (row->phase + 2) & 3;
+}
+
+static void apply_cx(stabilizer_state *state, const ulong control, const ulong target)
+{
+	if(state->reference & control)
+		state->reference ^= target;
+	std::vector<pauli_row>::iterator row;
+	// X_c -> X_c X_t, Z_t -> Z_c Z_t; при порядке X, потом Z фаза не меняется
+	for(row = state->rows.begin(); row != state->rows.end(); ++row)
+	{
+		if(row->x & control)
+			row->x ^= target;
+		if(row->z & target)
+			row->z ^= control;
+	}
+}
+
+static void apply_cz(stabilizer_state *state, const ulong mask1, const ulong mask2)
+{
+	if((state->reference & mask1) && (state->reference & mask2))
+		state->amplitude = -state->amplitude;
+	std::vector<pauli_row>::iterator row;
+	// X_1 -> X_1 Z_2, X_2 -> Z_1 X_2
+	for(row = state->rows.begin(); row != state->rows.end(); ++row)
+	{
+		const bool x1 = row->x & mask1, x2 = row->x & mask2;
+		if(x1)
+			row->z ^= mask2;
+		if(x2)
+			row->z ^= mask1;
+		if(x1 && x2)
+			row->phase = (row->phase + 2) & 3;
+	}
+}
+
+static void swap_bits(ulong *value, const ulong mask1, const ulong mask2)
+{
+	if(!(*value & mask1) != !(*value & mask2))
+		*value ^= mask1 | mask2;
+}
+
+static void apply_swap(stabilizer_state *state, const ulong mask1, const ulong mask2)
+{
+	swap_bits(&state->reference, mask1, mask2);
+	std::vector<pauli_row>::iterator row;
+	for(row = state->rows.begin(); row != state->rows.end(); ++row) {
+		swap_bits(&row->x, mask1, mask2);
+		swap_bits(&row->z, mask1, mask2);
+	}
+}
+
+// RZ(k*pi/2) = e^{-i*k*pi/4} diag(1, i^k)
+static void apply_rz(stabilizer_state *state, const ulong mask, const double angle)
+{
+	int multiple;
+	angle_multiple(angle, pi / 2, &multiple);
+	state->amplitude *= std::polar(1.0, -angle / 2);
+	apply_phase(state, mask, multiple);
+}
+
+void stabilizer_apply_circuit(stabilizer_state *state, const gate *gates, const size_t count, size_t *applied)
+{
+	const size_t n = state->number_of_qubits;
+	int multiple;
+	size_t g;
+	for(g = 0; g < count && is_clifford(gates[g]); g++)
+	{
+		const gate &current = gates[g];
+		const ulong mask0 = 1UL << (n - current.qubits[0]);
+		const ulong mask1 = current.qubits_num > 1 ? 1UL << (n - current.qubits[1]) : 0;
+		switch(current.type)
+		{
+			case GATE_H:
+				apply_hadamard(state, mask0);
+				break;
+			case GATE_X:
+				apply_x(state, mask0);
+				break;
+			case GATE_Z:
+				apply_phase(state, mask0, 2);
+				break;
+			case GATE_RZ:
+				apply_rz(state, mask0, current.param);
+				break;
+			case GATE_RX:
+				// RX = H RZ H
+				apply_hadamard(state, mask0);
+				apply_rz(state, mask0, current.param);
+				apply_hadamard(state, mask0);
+				break;
+			case GATE_CX:
+				apply_cx(state, mask0, mask1);
+				break;
+			case GATE_CP:
+				angle_multiple(current.param, pi, &multiple);
+				if(multiple % 2)
+					apply_cz(state, mask0, mask1);
+				break;
+			case GATE_SWAP:
+				apply_swap(state, mask0, mask1);
+				break;
+			default:
+				break;
+		}
+	}
+	*applied = g;
+}
+
+void stabilizer_to_dense(const stabilizer_state *state, complexd *portion)
+{
+	const size_t n = state->number_of_qubits;
+	const ulong portion_size = (1UL << n) / proc_num;
+	const ulong first_index = myrank * portion_size, local_mask = portion_size - 1;
+	long i;
+	const long size = portion_size;
+	#pragma omp parallel for
+	for(i = 0; i < size; i++)
+		portion[i] = 0;
+	std::vector<pauli_row> rows(state->rows);
+	const size_t k = reduce_rows(rows, n);
+	// строки с глобальными ведущими битами однозначно задаются номером процесса
+	pauli_row base = { 0, 0, 0 };
+	std::vector<pauli_row> local;
+	size_t j;
+	for(j = 0; j < k; j++)
+	{
+		const ulong pivot = top_bit(rows[j].x);
+		if(pivot <= local_mask)
+			local.push_back(rows[j]);
+		else if(((state->reference ^ base.x) & pivot) != (first_index & pivot))
+			base = multiply(base, rows[j]);
+	}
+	if(((state->reference ^ base.x) & ~local_mask) != first_index)
+		return;
+	// по старшим локальным строкам - куски для потоков, внутри куска - код Грея по младшим
+	const size_t chunk_rows = std::min(local.size(), size_t(8)), gray_rows = local.size() - chunk_rows;
+	const long chunks = 1L << chunk_rows;
+	long c;
+	#pragma omp parallel for private(j)
+	for(c = 0; c < chunks; c++)
+	{
+		pauli_row element = base;
+		for(j = 0; j < chunk_rows; j++)
+			if(c & (1L << j))
+				element = multiply(element, local[j]);
+		ulong step;
+		for(step = 1; ; step++)
+		{
+			portion[(state->reference ^ element.x) & local_mask] = element_amplitude(element, state->reference, state->amplitude);
+			if(step == 1UL << gray_rows)
+				break;
+			element = multiply(element, local[chunk_rows + lowest_bit_number(step)]);
+		}
+	}
+}
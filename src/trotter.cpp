@@ -0,0 +1,183 @@
+#include "trotter.h"
+#include "observe.h"
+#include "optimize.h"
+
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+
+static const double pi = std::acos(-1);
+
+int read_hamiltonian(const char *filename, const size_t number_of_qubits, std::vector<pauli_term> &terms)
+{
+	std::ifstream in(filename);
+	if(!in) {
+		if(i_am_the_master)
+			fprintf(stderr, "Cannot open file %s\n", filename);
+		return NOT_SUCCESS;
+	}
+	terms.clear();
+	std::string line;
+	size_t line_number = 0;
+	while(std::getline(in, line))
+	{
+		line_number++;
+		line = line.substr(0, line.find('#'));
+		std::istringstream fields(line);
+		if(line.find_first_not_of(" \t\r") == std::string::npos)
+			continue;
+		pauli_term term;
+		if(!(fields >> term.coefficient >> term.paulis) || term.paulis.size() != number_of_qubits
+			|| term.paulis.find_first_not_of("IXYZ") != std::string::npos) {
+			if(i_am_the_master)
+				fprintf(stderr, "Wrong term in %s, line %zu: expected a coefficient and %zu of I, X, Y, Z\n", filename,
+					line_number, number_of_qubits);
+			return WRONG_VALUE;
+		}
+		terms.push_back(term);
+	}
+	return SUCCESS;
+}
+
+bool is_diagonal(const pauli_term &term)
+{
+	return term.paulis.find_first_of("XY") == std::string::npos;
+}
+
+// Строки Паули коммутируют, если различаются в четном числе позиций, где обе не I
+static bool commute(const pauli_term &a, const pauli_term &b)
+{
+	size_t k, different = 0;
+	for(k = 0; k < a.paulis.size(); k++)
+		different += a.paulis[k] != 'I' && b.paulis[k] != 'I' && a.paulis[k] != b.paulis[k];
+	return different % 2 == 0;
+}
+
+// exp(-i*angle*P) вентилями: V, лестница CX, RZ(2*angle), обратная лестница, V^+;
+// V переводит P в строку Z: H для X, RX(pi/2) для Y
+static void term_gates(const pauli_term &term, const double angle, std::vector<gate> &gates)
+{
+	std::vector<size_t> qubits;
+	size_t k;
+	for(k = 0; k < term.paulis.size(); k++)
+		if(term.paulis[k] != 'I')
+			qubits.push_back(k + 1);
+	if(qubits.size() == 1 && term.paulis[qubits[0] - 1] == 'X') {
+		gates.push_back(make_gate1(GATE_RX, qubits[0], 2 * angle));
+		return;
+	}
+	for(k = 0; k < qubits.size(); k++)
+		if(term.paulis[qubits[k] - 1] == 'X')
+			gates.push_back(make_gate1(GATE_H, qubits[k]));
+		else if(term.paulis[qubits[k] - 1] == 'Y')
+			gates.push_back(make_gate1(GATE_RX, qubits[k], pi / 2));
+	for(k = 0; k + 1 < qubits.size(); k++)
+		gates.push_back(make_gate2(GATE_CX, qubits[k], qubits[k + 1]));
+	gates.push_back(make_gate1(GATE_RZ, qubits.back(), 2 * angle));
+	for(k = qubits.size() - 1; k > 0; k--)
+		gates.push_back(make_gate2(GATE_CX, qubits[k - 1], qubits[k]));
+	for(k = 0; k < qubits.size(); k++)
+		if(term.paulis[qubits[k] - 1] == 'X')
+			gates.push_back(make_gate1(GATE_H, qubits[k]));
+		else if(term.paulis[qubits[k] - 1] == 'Y')
+			gates.push_back(make_gate1(GATE_RX, qubits[k], -pi / 2));
+}
+
+void split_diagonal(const std::vector<pauli_term> &terms, const size_t number_of_qubits, diagonal_part *diagonal,
+	std::vector<pauli_term> *others)
+{
+	size_t k, j;
+	for(k = 0; k < terms.size(); k++)
+	{
+		if(!is_diagonal(terms[k])) {
+			if(others != NULL)
+				others->push_back(terms[k]);
+			continue;
+		}
+		ulong mask = 0;
+		for(j = 0; j < number_of_qubits; j++)
+			if(terms[k].paulis[j] == 'Z')
+				mask |= 1UL << (number_of_qubits - 1 - j);
+		diagonal->z_masks.push_back(mask);
+		diagonal->coefficients.push_back(terms[k].coefficient);
+	}
+}
+
+// exp(-i*tau*D) одним проходом
+static void diagonal_pass(complexd *portion, const ulong portion_size, const diagonal_part *diagonal, const double tau)
+{
+	const ulong first = myrank * portion_size;
+	long i;
+	const long size = portion_size;
+	#pragma omp parallel for
+	for(i = 0; i < size; i++)
+		portion[i] *= std::polar(1.0, -tau * diagonal_value(diagonal, first + i));
+}
+
+static int observe(const complexd *portion, const size_t number_of_qubits, const trotter_options *options, const size_t step,
+	std::vector<trotter_sample> &samples)
+{
+	trotter_sample sample;
+	sample.step = step;
+	sample.time = options->time * step / options->steps;
+	sample.values.resize(options->observables.size());
+	int code = SUCCESS;
+	size_t k;
+	for(k = 0; k < options->observables.size() && code == SUCCESS; k++)
+		code = pauli_expectation(portion, number_of_qubits, options->observables[k], &sample.values[k]);
+	samples.push_back(sample);
+	return code;
+}
+
+int trotter_evolve(complexd *portion, const size_t number_of_qubits, const std::vector<pauli_term> &terms,
+	const trotter_options *options, std::vector<trotter_sample> &samples)
+{
+	const ulong portion_size = (1UL << number_of_qubits) / proc_num;
+	const double tau = options->time / options->steps;
+	diagonal_part diagonal;
+	std::vector<pauli_term> others;
+	split_diagonal(terms, number_of_qubits, &diagonal, &others);
+	size_t k, j;
+	bool commuting = true;
+	for(k = 0; k < others.size(); k++)
+		for(j = k + 1; j < others.size(); j++)
+			commuting = commuting && commute(others[k], others[j]);
+	// недиагональная часть шага строится один раз
+	std::vector<gate> layer;
+	if(options->order == 2 && !commuting)
+	{
+		for(k = 0; k < others.size(); k++)
+			term_gates(others[k], others[k].coefficient * tau / 2, layer);
+		for(k = others.size(); k > 0; k--)
+			term_gates(others[k - 1], others[k - 1].coefficient * tau / 2, layer);
+	}
+	else
+		for(k = 0; k < others.size(); k++)
+			term_gates(others[k], others[k].coefficient * tau, layer);
+	optimize_circuit(layer, number_of_qubits);
+	const bool has_diagonal = !diagonal.z_masks.empty();
+	int code = SUCCESS;
+	if(options->observe_every > 0)
+		code = observe(portion, number_of_qubits, options, 0, samples);
+	// при order 2 половина D предыдущего шага еще не применена
+	bool half_pending = false;
+	size_t step;
+	for(step = 1; step <= options->steps && code == SUCCESS; step++)
+	{
+		if(has_diagonal)
+			diagonal_pass(portion, portion_size, &diagonal, options->order == 2 ? (half_pending ? tau : tau / 2) : tau);
+		code = apply_circuit_dense(portion, number_of_qubits, layer.data(), layer.size());
+		half_pending = options->order == 2;
+		const bool observed = step == options->steps || (options->observe_every > 0 && step % options->observe_every == 0);
+		if(observed && half_pending)
+		{
+			if(has_diagonal)
+				diagonal_pass(portion, portion_size, &diagonal, tau / 2);
+			half_pending = false;
+		}
+		if(observed && code == SUCCESS)
+			code = observe(portion, number_of_qubits, options, step, samples);
+	}
+	return code;
+}